@@ -32,6 +32,9 @@
 #include "tools/text.h"
 #include "tools/record.h"
 #include "tools/console.h"
+#include "tools/shards.h"
+#include "tools/progress.h"
+#include "tools/sweep.h"
 
 #if defined(SUPPORT_NCURSES)
 #include <ncurses.h>
@@ -57,6 +60,8 @@ std::atomic<bool>           bKeepRunnig(true);
 bool                        bScreensaverMode = false;
 bool                        bRunAtFullFps = false;
 bool                        bTerminate = false;
+bool                        bVSync = true;
+bool                        bExporting = false;     // rendering a recording offscreen, see export_offscreen
 #if !defined(__EMSCRIPTEN__)
 void                        printUsage(char * executableName);
 void                        onExit();
@@ -130,6 +135,24 @@ char* getVert() {
 std::mutex                  oscMutex;
 #endif
 int                         oscPort = 0;
+
+// Progress of recordings, published as "progress,..." lines on stdout and/or OSC messages
+bool                        progressLines = false;
+int                         progressInterval = 250;     // ms between reports
+#if defined(SUPPORT_OSC)
+std::string                 progressOscHost = "";
+std::string                 progressOscPort = "";
+#endif
+void                        commandsWaitRecording();
+
+// Batch renders of a shader over a set of uniform/define values, see the sweep command
+ParameterSweep              sweep;
+void                        sweepStep();
+
+#if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
+// Default settings for the record command
+RecordingSettings           recordSettings;
+#endif
 // MAIN LOOP
 #if defined(__EMSCRIPTEN__)
 EM_BOOL loop (double time, void* userData) {
@@ -142,6 +165,14 @@ void loop() {
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
     #ifndef __EMSCRIPTEN__
+    // Parameter sweeps set their values here, between frames, so each one lands whole on its own frame.
+    // The clock holds still meanwhile, every sample sees the same u_time
+    bool sweeping = sweep.isRunning();
+    if (sweeping != sandbox.isTimeHeld())
+        sandbox.holdTime(sweeping);
+    if (sweeping)
+        sweepStep();
+
     // If nothing in the scene change skip the frame and try to keep it at 60fps
     if (!bTerminate && !bRunAtFullFps && !sandbox.haveChange()) {
         std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
@@ -156,6 +187,13 @@ void loop() {
     }
     #endif
 
+    // Offscreen exports don't wait for the display, vsync comes back once they are done
+    bool exporting = sandbox.exportOffscreen && isRecording();
+    if (exporting != bExporting) {
+        vera::setWindowVSync(bVSync && !exporting);
+        bExporting = exporting;
+    }
+
     // PREP for main render:
     //  - update uniforms
     //  - render buffers, double buffers and pyramid convolutions
@@ -178,7 +216,9 @@ void loop() {
     //  - draw render passes/buffers (debug)
     //  - draw plot widget (debug)
     //  - draw cursor
-    sandbox.renderUI();
+    // Note: offscreen exports skip it, except on preview frames
+    if (sandbox.isPresenting())
+        sandbox.renderUI();
 
     // Finish rendering triggering some events like
     //  - save image/frame if it's needed
@@ -186,15 +226,17 @@ void loop() {
     sandbox.renderDone();
 
 #ifndef __EMSCRIPTEN__
-    if ( bTerminate && sandbox.screenshotFile == "" )
+    if ( bTerminate && sandbox.screenshotFile == "" && sandbox.tiledFile == "" )
         bKeepRunnig.store(false);
     else
 #endif
     
-    // Swap GL buffer
-    TRACK_BEGIN("render:swap")
-    vera::renderGL();    
-    TRACK_END("render:swap")
+    // Swap GL buffer (offscreen exports only for the previews)
+    if (sandbox.isPresenting()) {
+        TRACK_BEGIN("render:swap")
+        vera::renderGL();    
+        TRACK_END("render:swap")
+    }
 
     #if defined(__EMSCRIPTEN__)
     return (vera::getXR() == vera::NONE_XR_MODE);
@@ -214,6 +256,10 @@ int main(int argc, char **argv) {
     bool haveFragmentShader = false;
     bool haveGeometry = false;
     bool haveTextures = false;
+    int  shardWorkers = 0;
+    int  shardFrames = 0;
+    std::string streamOut = "";
+    std::string streamFormat = "y4m";
 
     for (int i = 1; i < argc ; i++) {
         std::string argument = std::string(argv[i]);
@@ -300,6 +346,26 @@ int main(int argc, char **argv) {
             else
                 std::cout << "Argument '" << argument << "' should be followed by a the OPENGL MINOR version. Skipping argument." << std::endl;
         }
+        else if (   argument == "-shards"       || argument == "--shards" ) {
+            if (++i < argc) {
+                std::vector<std::string> values = vera::split(std::string(argv[i]), ',');
+                shardWorkers = vera::toInt(values[0]);
+                if (values.size() > 1)
+                    shardFrames = vera::toInt(values[1]);
+            }
+            else
+                std::cout << "Argument '" << argument << "' should be followed by a <workers>. Skipping argument." << std::endl;
+        }
+        else if (   argument == "-stream-out"   || argument == "--stream-out" ) {
+            if (++i < argc) {
+                std::vector<std::string> values = vera::split(std::string(argv[i]), ',');
+                streamOut = values[0];
+                if (values.size() > 1)
+                    streamFormat = values[1];
+            }
+            else
+                std::cout << "Argument '" << argument << "' should be followed by a <file>. Skipping argument." << std::endl;
+        }
         else if ( vera::haveExt(argument,"vert") || vera::haveExt(argument,"vs") ) {
             haveVertexShader = true;
         }
@@ -341,6 +407,63 @@ int main(int argc, char **argv) {
     }
     #endif
 
+    // Streamed frames may take over stdout, from here on the console goes to stderr
+    if (streamOut != "") {
+        if (shardWorkers > 0) {
+            std::cerr << "--stream-out can't be used with --shards" << std::endl;
+            exit(1);
+        }
+
+        commands_ncurses = false;
+        if (!sandbox.getFrameStream().open(streamOut, toFrameStreamFormat(streamFormat)))
+            exit(1);
+
+        // frames go only down the stream unless other sinks are asked for
+        sandbox.sequenceFormat = "none";
+    }
+
+    // Sharded renders: this process only coordinates headless workers running the same arguments
+    if (shardWorkers > 0) {
+        ShardSettings shards;
+        shards.workers = shardWorkers;
+        shards.frames = shardFrames;
+
+        bool haveRange = false;
+        for (int i = 1; i < argc ; i++) {
+            std::string argument = std::string(argv[i]);
+            if (argument == "-shards" || argument == "--shards") {
+                i++;
+                continue;
+            }
+
+            if ((argument == "-e" || argument == "-E") && i + 1 < argc) {
+                std::string command = std::string(argv[i + 1]);
+                if (parseShardRange(command, shards)) {
+                    haveRange = true;
+                    i++;
+                    continue;
+                }
+
+                std::vector<std::string> values = vera::split(command, ',');
+                if (values.size() == 2 && values[0] == "sequence_format")
+                    shards.format = values[1];
+
+                // only the range command ends the workers
+                shards.args.push_back("-e");
+                shards.args.push_back(command);
+                i++;
+                continue;
+            }
+            shards.args.push_back(argument);
+        }
+
+        if (!haveRange) {
+            std::cerr << "--shards needs a sequence, secs or frames command (-e or -E) to split" << std::endl;
+            exit(1);
+        }
+        exit( runShards(argv[0], shards) );
+    }
+
     // Declare global level commands
     commandsInit();
 
@@ -373,7 +496,9 @@ int main(int argc, char **argv) {
                     argument == "-mouse"    || argument == "--mouse"        ||
                 #endif
                     argument == "--major"   || argument == "--major"        || 
-                    argument == "--minor"   || argument == "--minor"    ) {
+                    argument == "--minor"   || argument == "--minor"        ||
+                    argument == "-shards"   || argument == "--shards"   ||
+                    argument == "-stream-out"   || argument == "--stream-out" ) {
             i++;
         }
         
@@ -948,6 +1073,72 @@ void commandsRun(const std::string &_cmd, std::mutex &_mutex) {
     }
 }
 
+// Sets the values of the next sample of the running sweep and asks for its frame to be saved
+void sweepStep() {
+    // the previous frame is still on its way to disk
+    if (sandbox.screenshotFile != "")
+        return;
+
+    std::vector<std::string> values;
+    std::string file;
+    if (!sweep.next(values, file)) {
+        sweep.finish();
+        return;
+    }
+
+    // shaders only get recompiled when a define actually changes
+    const std::vector<SweepParameter>& parameters = sweep.getParameters();
+    for (size_t i = 0; i < parameters.size(); i++) {
+        if (parameters[i].define) {
+            if (sweep.updateDefine(parameters[i].name, values[i]))
+                sandbox.addDefine(parameters[i].name, values[i]);
+        }
+        else {
+            // this frame has to use exactly this value, not whatever was queued for it
+            sandbox.uniforms.setNow(parameters[i].name, vera::toFloat(values[i]));
+        }
+    }
+
+    sandbox.screenshotFile = file;
+    sandbox.flagChange();
+}
+
+// Follows the recording started by a command until all its frames are rendered and saved or encoded.
+// Progress is pushed by the render and save threads, so this doesn't lock the commands mutex
+void commandsWaitRecording() {
+    RecordingProgress progress;
+    uint64_t id = 0;
+    std::chrono::steady_clock::time_point lastReport;
+
+    #if defined(SUPPORT_OSC)
+    std::unique_ptr<lo::Address> osc;
+    if (progressOscHost != "")
+        osc.reset( new lo::Address(progressOscHost, progressOscPort) );
+    #endif
+
+    do {
+        waitProgress(progress, id, 1000);
+        id = progress.id;
+
+        // events come with every frame, reports go out at most every progressInterval
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!progress.done && std::chrono::duration_cast<std::chrono::milliseconds>(now - lastReport).count() < progressInterval)
+            continue;
+        lastReport = now;
+
+        console_draw_pct( (progress.total > 0)? std::min(1.0f, (float)progress.rendered / (float)progress.total) : 1.0f );
+
+        if (progressLines)
+            std::cout << toString(progress) << std::endl;
+
+        #if defined(SUPPORT_OSC)
+        if (osc)
+            osc->send("/progress", "iiiifffh", progress.rendered, progress.total, progress.encoded, progress.queued,
+                      progress.renderFps, progress.encodeFps, progress.eta, (int64_t)progress.bytes);
+        #endif
+    } while (!progress.done);
+}
+
 void commandsInit() {
     // GET only commands
     //
@@ -1192,6 +1383,20 @@ void commandsInit() {
     },
     "screenshot[,<filename>]", "saves a screenshot to a filename", false));
 
+    commands.push_back(Command("screenshot_tiled", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 4) {
+            commandsMutex.lock();
+            sandbox.tiledSize = glm::ivec2(vera::toInt(values[2]), vera::toInt(values[3]));
+            sandbox.tileSize = (values.size() >= 5)? vera::toInt(values[4]) : 0;
+            sandbox.tiledFile = values[1];
+            commandsMutex.unlock();
+            return true;
+        }
+        return false;
+    },
+    "screenshot_tiled,<filename>,<width>,<height>[,<tile_size>]", "renders a png (or tga up to 65535x65535) screenshot of any size by tiles, streaming them to the file. 2D shaders have to use u_view2d. Not for shaders with buffers or post-processing", false));
+
     commands.push_back(Command("sequence", [&](const std::string& _line){ 
         std::vector<std::string> values = vera::split(_line,',');
         if (values.size() >= 3) {
@@ -1210,17 +1415,7 @@ void commandsInit() {
             recordingStartSecs(from, to, fps);
             commandsMutex.unlock();
 
-            float pct = 0.0f;
-            while (pct < 1.0f) {
-                // get progres.
-                commandsMutex.lock();
-                pct = getRecordingPercentage();
-                commandsMutex.unlock();
-
-                console_draw_pct(pct);
-
-                std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
-            }
+            commandsWaitRecording();
             return true;
         }
         return false;
@@ -1245,17 +1440,7 @@ void commandsInit() {
             recordingStartSecs(from, to, fps);
             commandsMutex.unlock();
 
-            float pct = 0.0f;
-            while (pct < 1.0f) {
-                // get progres.
-                commandsMutex.lock();
-                pct = getRecordingPercentage();
-                commandsMutex.unlock();
-
-                console_draw_pct(pct);
-
-                std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
-            }
+            commandsWaitRecording();
             return true;
         }
         return false;
@@ -1279,18 +1464,7 @@ void commandsInit() {
             recordingStartFrames(from, to, fps);
             commandsMutex.unlock();
 
-            float pct = 0.0f;
-            while (pct < 1.0f) {
-
-                // Check progres.
-                commandsMutex.lock();
-                pct = getRecordingPercentage();
-                commandsMutex.unlock();
-                
-                console_draw_pct(pct);
-
-                std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
-            }
+            commandsWaitRecording();
             return true;
         }
         return false;
@@ -1301,7 +1475,7 @@ void commandsInit() {
     commands.push_back(Command("record", [&](const std::string& _line){ 
         std::vector<std::string> values = vera::split(_line,',');
         if (values.size() >= 3) {
-            RecordingSettings settings;
+            RecordingSettings settings = recordSettings;
             settings.src_width = vera::getWindowWidth();
             settings.src_height = vera::getWindowHeight();
             settings.src_fps = vera::getFps();
@@ -1332,23 +1506,39 @@ void commandsInit() {
             settings.trg_width = (int)(settings.src_width);
             settings.trg_height = (int)(settings.src_height);
 
+            // when frames are also saved as images, the video takes the same RGBA readback
+            if (sandbox.captureSinks.size() > 0) {
+                settings.src_channels = 4;
+                settings.src_yuv = false;
+            }
+
             bool valid = false;
             if (vera::haveExt(values[1], "mp4") || vera::haveExt(values[1], "MP4") ) {
                 settings.trg_width = vera::roundTo( settings.trg_width, 2);
                 settings.trg_height = vera::roundTo( settings.trg_height , 2);
 
+                // YUV420 frames need even dimensions
+                if (settings.src_width % 2 != 0 || settings.src_height % 2 != 0)
+                    settings.src_yuv = false;
+
                 valid = true;
+                // the in-process encoder takes the same codec settings (see videoEncoder.h)
+                settings.trg_codec.codec = "libx264";
+                settings.trg_codec.bitrate = 20000000;
+                settings.trg_codec.crf = 18;
+                settings.trg_codec.gop = 1;
+
                 settings.trg_args = "-r " + vera::toString( settings.trg_fps );
-                settings.trg_args += " -c:v libx264";
-                settings.trg_args += " -b:v 20000k";
-                settings.trg_args += " -vf \"vflip,fps=" + vera::toString(settings.trg_fps);
+                settings.trg_args += " -c:v " + settings.trg_codec.codec;
+                settings.trg_args += " -b:v " + vera::toString( (int)(settings.trg_codec.bitrate / 1000) ) + "k";
+                settings.trg_args += " -vf \"" + std::string(settings.src_yuv? "" : "vflip,") + "fps=" + vera::toString(settings.trg_fps);
                 if (pd > 1)
                     settings.trg_args += ",scale=" + vera::toString(settings.trg_width,0) + ":" + vera::toString(settings.trg_height,0) + ":flags=lanczos";
                 settings.trg_args += "\"";
-                settings.trg_args += " -crf 18 ";
+                settings.trg_args += " -crf " + vera::toString( settings.trg_codec.crf ) + " ";
                 settings.trg_args += " -pix_fmt yuv420p";
                 settings.trg_args += " -vsync 1";
-                settings.trg_args += " -g 1";
+                settings.trg_args += " -g " + vera::toString( settings.trg_codec.gop );
             }
             else if (vera::haveExt(values[1], "gif") || vera::haveExt(values[1], "GIF") ) {;
                 settings.trg_width = vera::roundTo( (int)((settings.trg_width/pd)/2), 2);
@@ -1360,6 +1550,8 @@ void commandsInit() {
                     settings.trg_args += ",scale=" + vera::toString((float)settings.trg_width,0) + ":" + vera::toString((float)settings.trg_height,0) + ":flags=lanczos";
                 settings.trg_args += ",split[s0][s1];[s0]palettegen[p];[s1][p]paletteuse\"";
                 settings.trg_args += " -loop 0";
+                settings.libav = false;     // palette generation is left to ffmpeg
+                settings.src_yuv = false;
             }
 
             if (valid) {
@@ -1367,16 +1559,7 @@ void commandsInit() {
                 recordingPipeOpen(settings, from, to);
                 commandsMutex.unlock();
 
-                float pct = 0.0f;
-                while (pct < 1.0f) {
-                    commandsMutex.lock();
-                    pct = getRecordingPercentage();
-                    commandsMutex.unlock();
-
-                    console_draw_pct(pct);
-
-                    std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
-                }
+                commandsWaitRecording();
             }
 
             return true;
@@ -1384,8 +1567,137 @@ void commandsInit() {
         return false;
     },
     "record,<file>,<A>,<B>[,<fps>]","record a video from second <A> to second <B> at <fps> (default: 24.0f)", false));
+
+    commands.push_back(Command("record_queue", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 2) {
+            int capacity = vera::toInt(values[1]);
+            recordSettings.queue_capacity = (capacity > 0)? capacity : 1;
+            if (values.size() >= 3)
+                recordSettings.queue_policy = (values[2] == "drop")? QUEUE_DROP : QUEUE_BLOCK;
+            return true;
+        }
+        else {
+            std::cout << recordSettings.queue_capacity << "," << ((recordSettings.queue_policy == QUEUE_DROP)? "drop" : "block") << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "record_queue[,<frames>[,block|drop]]","get or set how many frames can wait to be encoded and if new frames block or are dropped when it's full", false));
+
+    commands.push_back(Command("record_encoder", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            recordSettings.libav = (values[1] == "libav");
+            return true;
+        }
+        else {
+            std::cout << (recordSettings.libav? "libav" : "ffmpeg") << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "record_encoder[,ffmpeg|libav]","get or set if videos are piped into an ffmpeg process (default) or encoded in-process (libav) with the same codec settings", false));
+
+    commands.push_back(Command("record_yuv", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            recordSettings.src_yuv = (values[1] == "on");
+            return true;
+        }
+        else {
+            std::cout << (recordSettings.src_yuv? "on" : "off") << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "record_yuv[,on|off]","get or set if mp4 frames are flipped and converted to YUV420 on the GPU before reading them back", false));
+
+    commands.push_back(Command("record_realtime", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            recordSettings.realtime = (values[1] == "on");
+            return true;
+        }
+        else {
+            std::cout << (recordSettings.realtime? "on" : "off") << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "record_realtime[,on|off]","get or set if recorded frames are fed to the encoder at the recording fps (live capture) instead of as fast as it takes them", false));
+    #endif
+
+    commands.push_back(Command("progress", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values[0] != "progress")
+            return false;
+
+        if (values.size() >= 2) {
+            progressLines = (values[1] == "on");
+            if (values.size() >= 3)
+                progressInterval = std::max(0, vera::toInt(values[2]));
+            return true;
+        }
+        else {
+            std::cout << (progressLines? "on" : "off") << "," << progressInterval << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "progress[,on|off[,<ms>]]","print the progress of sequences and recordings every <ms> as progress,<rendered>,<total>,<encoded>,<queued>,<render_fps>,<encode_fps>,<eta>,<bytes>", false));
+
+    #if defined(SUPPORT_OSC)
+    commands.push_back(Command("progress_osc", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2 && values[1] == "off") {
+            progressOscHost = "";
+            return true;
+        }
+        else if (values.size() == 3) {
+            progressOscHost = values[1];
+            progressOscPort = values[2];
+            return true;
+        }
+        else if (values.size() == 1) {
+            if (progressOscHost != "")
+                std::cout << progressOscHost << "," << progressOscPort << std::endl;
+            else
+                std::cout << "off" << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "progress_osc[,off|<host>,<port>]","send the progress of sequences and recordings as /progress OSC messages (same values as the progress command)", false));
     #endif
 
+    commands.push_back(Command("sweep", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            if (values[1] == "stop") {
+                sweep.stop();
+                return true;
+            }
+
+            commandsMutex.lock();
+            bool loaded = sweep.load(values[1]);
+            if (loaded)
+                sweep.start();
+            commandsMutex.unlock();
+
+            if (loaded) {
+                std::cout << "// sweep of " << sweep.getTotal() << " frames" << std::endl;
+                sweep.wait();
+                // the last frame is taken by now, not necessarily written
+                sandbox.waitSaves();
+                std::cout << "// sweep done, " << sweep.getCurrent() << " frames" << std::endl;
+            }
+            return true;
+        }
+        return false;
+    },
+    "sweep,<spec_file>|stop","renders a frame for each uniform/define combination of a sweep spec (see tools/sweep.h). u_time holds still until it's done", false));
+
     // GET / SET commands
     //
     commands.push_back(Command("fullFps", [&](const std::string& _line){
@@ -1428,7 +1740,8 @@ void commandsInit() {
         std::vector<std::string> values = vera::split(_line,',');
         if (values.size() == 2) {
             commandsMutex.lock();
-            vera::setWindowVSync(values[1] == "on");
+            bVSync = (values[1] == "on");
+            vera::setWindowVSync(bVSync);
             commandsMutex.unlock();
         }
         return false;
@@ -1652,6 +1965,8 @@ void printUsage(char * executableName) {
     std::cerr << "      -D<define>                  # add system #defines directly from the console argument" << std::endl;
     std::cerr << "      -p <OSC_port>               # open OSC listening port" << std::endl;
     std::cerr << "      -e  or -E <command>         # execute command when start. Multiple -e commands can be stack" << std::endl;
+    std::cerr << "      --shards <N>[,<frames>]     # split a sequence/secs/frames command between headless worker processes" << std::endl;
+    std::cerr << "      --stream-out <file>[,y4m|raw] # stream the recorded frames as Y4M or raw RGBA, - for stdout" << std::endl;
     std::cerr << "      -v  or --version            # return glslViewer version" << std::endl;
     std::cerr << "      --verbose                   # turn verbose outputs on" << std::endl;
     std::cerr << "      --help                      # print help for one or all command" << std::endl;
@@ -1659,6 +1974,9 @@ void printUsage(char * executableName) {
 
 void onExit() {
 
+    // a recording stopped halfway still has frames being read back
+    sandbox.flushCapture();
+
     #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
     recordingPipeClose();
     #endif
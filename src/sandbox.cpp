@@ -2,6 +2,7 @@
 
 #include <sys/stat.h>   // stat
 #include <algorithm>    // std::find
+#include <cstring>      // memcpy
 #include <fstream>
 #include <math.h>
 #include <memory>
@@ -10,6 +11,9 @@
 #include "tools/text.h"
 #include "tools/record.h"
 #include "tools/console.h"
+#include "tools/yuv420.h"
+#include "tools/accumulate.h"
+#include "tools/progress.h"
 
 #include "vera/ops/fs.h"
 #include "vera/window.h"
@@ -38,7 +42,7 @@
 
 // ------------------------------------------------------------------------- CONTRUCTOR
 Sandbox::Sandbox(): 
-    screenshotFile(""), lenticular(""), quilt(-1), 
+    screenshotFile(""), sequenceFormat("png"), sequenceAbsolute(false), captureAovsFormat("exr"), tiledFile(""), tiledSize(0), tileSize(0), exportOffscreen(false), exportPreview(1.0f), lenticular(""), quilt(-1), 
     frag_index(-1), vert_index(-1), geom_index(-1), 
     verbose(false), cursor(true), fxaa(false),
     // Main Vert/Frag/Geom
@@ -53,15 +57,20 @@ Sandbox::Sandbox():
     m_plot(PLOT_OFF),
 
     // Record
+    m_record_jitter_offset(0.0), m_record_jitter(0.0f), m_record_jitter_camera(false), m_record_jitter_projection(vera::ProjectionType::PERSPECTIVE),
+    m_record_pooled(false), m_record_aovs(false), m_record_fbo_float(false), m_present(true),
     #if defined(SUPPORT_MULTITHREAD_RECORDING)
-    m_task_count(0),
     /** allow 500 MB to be used for the image save queue **/
-    m_max_mem_in_queue(500 * 1024 * 1024),
+    m_record_budget(500 * 1024 * 1024),
     m_save_threads(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1)),
+    m_save_pending(0),
     #endif
 
+    // Tiles
+    m_tile_resolution(0.0), m_tile_offset(0.0),
+
     // Scene
-    m_view2d(1.0), m_time_offset(0.0), m_camera_elevation(1.0), m_camera_azimuth(180.0), m_frame(0), m_error_screen(vera::SHOW_MAGENTA_SHADER), 
+    m_view2d(1.0), m_time_offset(0.0), m_time_hold(0.0), m_time_held(false), m_camera_elevation(1.0), m_camera_azimuth(180.0), m_frame(0), m_error_screen(vera::SHOW_MAGENTA_SHADER), 
     m_change(true), m_update_buffers(true), m_initialized(false), 
 
     // Debug
@@ -83,11 +92,11 @@ Sandbox::Sandbox():
 
     uniforms.functions["u_time"] = UniformFunction( "float", [&](vera::Shader& _shader) {
         if (isRecording()) _shader.setUniform("u_time", getRecordingTime());
-        else _shader.setUniform("u_time", float(vera::getTime()) - m_time_offset);
+        else _shader.setUniform("u_time", _getTime());
     }, 
     [&]() {  
         if (isRecording()) return vera::toString( getRecordingTime() );
-        else return vera::toString(vera::getTime() - m_time_offset); 
+        else return vera::toString(_getTime()); 
     } );
 
     uniforms.functions["u_delta"] = UniformFunction("float", [&](vera::Shader& _shader) {
@@ -111,14 +120,27 @@ Sandbox::Sandbox():
     []() { return vera::toString(vera::getMouseX(),1) + "," + vera::toString(vera::getMouseY(),1); } );
 
     // VIEWPORT
-    uniforms.functions["u_resolution"]= UniformFunction("vec2", [](vera::Shader& _shader) {
-        _shader.setUniform("u_resolution", float(vera::getWindowWidth()), float(vera::getWindowHeight()));
+    uniforms.functions["u_resolution"]= UniformFunction("vec2", [this](vera::Shader& _shader) {
+        // while rendering tiles shaders see the size of the whole image
+        if (m_tile_resolution.x > 0.0)
+            _shader.setUniform("u_resolution", m_tile_resolution);
+        else
+            _shader.setUniform("u_resolution", float(vera::getWindowWidth()), float(vera::getWindowHeight()));
     },
     []() { return vera::toString((float)vera::getWindowWidth(),1) + "," + vera::toString((float)vera::getWindowHeight(),1); });
 
     // SCENE
     uniforms.functions["u_view2d"] = UniformFunction("mat3", [this](vera::Shader& _shader) {
-        _shader.setUniform("u_view2d", m_view2d);
+        if (m_tile_resolution.x > 0.0) {
+            // the window pan/zoom scaled to the whole image, shifted to the tile being rendered
+            glm::vec2 scale = m_tile_resolution / glm::vec2(vera::getWindowWidth(), vera::getWindowHeight());
+            glm::mat3 view = glm::scale(glm::mat3(1.0), scale) * m_view2d * glm::scale(glm::mat3(1.0), 1.0f / scale);
+            _shader.setUniform("u_view2d", glm::translate(view, m_tile_offset + m_record_jitter_offset));
+        }
+        else if (m_record_jitter_offset != glm::vec2(0.0))
+            _shader.setUniform("u_view2d", glm::translate(m_view2d, m_record_jitter_offset));
+        else
+            _shader.setUniform("u_view2d", m_view2d);
     });
 
     uniforms.functions["u_modelViewProjectionMatrix"] = UniformFunction("mat4");
@@ -127,10 +149,10 @@ Sandbox::Sandbox():
 Sandbox::~Sandbox() {
     #if defined(SUPPORT_MULTITHREAD_RECORDING)
     /** make sure every frame is saved before exiting **/
-    if (m_task_count > 0)
+    if (m_record_budget.getJobs() > 0)
         std::cout << "saving remaining frames to disk, this might take a while ..." << std::endl;
     
-    while (m_task_count > 0)
+    while (m_record_budget.getJobs() > 0)
         std::this_thread::sleep_for(std::chrono::milliseconds{10});
     
     #endif
@@ -340,6 +362,7 @@ void Sandbox::commandsInit(CommandList &_commands ) {
     _commands.push_back(Command("reset", [&](const std::string& _line){
         if (_line == "reset") {
             m_time_offset = vera::getTime();
+            m_time_hold = 0.0f;
             return true;
         }
         return false;
@@ -349,7 +372,7 @@ void Sandbox::commandsInit(CommandList &_commands ) {
     _commands.push_back(Command("time", [&](const std::string& _line){ 
         if (_line == "time") {
             // Force the output in floats
-            std::cout << std::setprecision(6) << (vera::getTime() - m_time_offset) << std::endl;
+            std::cout << std::setprecision(6) << _getTime() << std::endl;
             return true;
         }
         return false;
@@ -371,6 +394,62 @@ void Sandbox::commandsInit(CommandList &_commands ) {
     },
     "defines", "return a list of active defines", false));
     
+    _commands.push_back(Command("automation", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        std::lock_guard<std::mutex> lock(m_automation_mutex);
+        if (values.size() == 1) {
+            if (m_automation.isRecording())
+                std::cout << "recording," << m_automation.getFile() << std::endl;
+            else if (m_automation.isPlaying())
+                std::cout << "playing," << m_automation.getFile() << "," << toString(m_automation.getInterpolation()) << " // " << m_automation.getTracks() << " tracks, " << m_automation.getKeys() << " keys, " << m_automation.getDuration() << " secs" << std::endl;
+            else
+                std::cout << "off" << std::endl;
+            return true;
+        }
+        else if (values[1] == "record" && values.size() == 3) {
+            m_automation.record(values[2]);
+            return true;
+        }
+        else if (values[1] == "stop") {
+            return m_automation.stop();
+        }
+        else if (values[1] == "play" && values.size() >= 3) {
+            return m_automation.load(values[2], toAutomationInterpolation( (values.size() >= 4)? values[3] : "linear" ));
+        }
+        else if (values[1] == "off") {
+            if (m_automation.isRecording())
+                m_automation.stop();
+            m_automation.clear();
+            return true;
+        }
+        return false;
+    },
+    "automation[,record,<file>|stop|play,<file>[,step|linear|spline]|off]", "record live uniform changes on u_time and replay them, frame by frame, while exporting"));
+
+    _commands.push_back(Command("uniform_policy", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 1) {
+            uniforms.printPolicies();
+            return true;
+        }
+        else if (values.size() >= 3) {
+            UniformPolicy policy = UNIFORM_LATEST;
+            if (values[2] == "average")
+                policy = UNIFORM_AVERAGE;
+            else if (values[2] == "queue")
+                policy = UNIFORM_QUEUE;
+            else if (values[2] != "latest")
+                return false;
+
+            size_t bound = (values.size() >= 4)? (size_t)std::max(1, vera::toInt(values[3])) : 64;
+            uniforms.setPolicy(values[1], policy, bound);
+            flagChange();
+            return true;
+        }
+        return false;
+    },
+    "uniform_policy[,<uniform>,latest|average|queue[,<bound>]]", "how values that arrive faster than frames are used: the latest, their average or one per frame (at most <bound> waiting)", false));
+
     _commands.push_back(Command("uniforms", [&](const std::string& _line){ 
         std::vector<std::string> values = vera::split(_line,',');
 
@@ -910,17 +989,273 @@ void Sandbox::commandsInit(CommandList &_commands ) {
     },
     "streams[,stop|play|restart|speed|prevs[,<value>]]", "print all streams or get/set streams speed and previous frames"));
 
+    _commands.push_back(Command("readback_depth", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            m_record_pbo.setDepth( vera::toInt(values[1]) );
+            m_record_pooled = false;
+            return true;
+        }
+        else {
+            std::cout << m_record_pbo.getDepth() << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "readback_depth[,<frames>]", "get or set how many frames of asynchronous pixel readback are kept in flight while recording (0 or 1 reads synchronously)"));
+
+    _commands.push_back(Command("sequence_format", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            sequenceFormat = values[1];
+            return true;
+        }
+        else {
+            std::cout << sequenceFormat << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "sequence_format[,png|tga|jpg|hdr|exr|none]", "get or set the image format used by sequence and frames"));
+
+    _commands.push_back(Command("sequence_numbering", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            sequenceAbsolute = (values[1] == "absolute");
+            return true;
+        }
+        else {
+            std::cout << (sequenceAbsolute? "absolute" : "relative") << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "sequence_numbering[,relative|absolute]", "get or set if sequence frames are numbered from zero or by their frame number"));
+
+    _commands.push_back(Command("sequence_journal", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 2) {
+            if (values[1] == "off")
+                m_record_journal.close();
+            else
+                return m_record_journal.open(values[1], values.size() >= 3 && values[2] == "resume");
+            return true;
+        }
+        else {
+            if (m_record_journal.isOpen())
+                std::cout << m_record_journal.getPath() << (m_record_journal.isResuming()? ",resume" : "") << std::endl;
+            else
+                std::cout << "off" << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "sequence_journal[,off|<filename>[,resume]]", "keep a journal of the saved frames of a sequence, resuming skips the frames already saved on it (double buffers and other feedback shaders don't see the skipped frames)"));
+
+    _commands.push_back(Command("shm_output", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 2) {
+            if (values[1] == "off") {
+                m_record_shm.close();
+                return true;
+            }
+            size_t bytes = (size_t)vera::getWindowWidth() * (size_t)vera::getWindowHeight() * 4;
+            return m_record_shm.open(values[1], bytes, (values.size() >= 3)? vera::toInt(values[2]) : 4);
+        }
+        else {
+            if (m_record_shm.isOpen())
+                std::cout << m_record_shm.getName() << "," << m_record_shm.getSlots() << std::endl;
+            else
+                std::cout << "off" << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "shm_output[,off|<name>[,<slots>]]", "publish the captured frames (screenshots, sequences and recordings) as raw RGBA on a POSIX shared memory ring of <slots>"));
+
+    _commands.push_back(Command("globals_ubo", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            if (values[1] == "off")
+                uniforms.globalsBlock.setEnabled(false);
+            else if (values[1] == "on")
+                uniforms.globalsBlock.setEnabled(true);
+            else if (GlobalsBlock::save(values[1]))
+                uniforms.globalsBlock.setEnabled(true);
+            else
+                return false;
+
+            // programs get their binding on the next feed
+            uniforms.flagProgramsChange();
+            flagChange();
+            return true;
+        }
+        else {
+            std::cout << (uniforms.globalsBlock.isEnabled()? "on" : "off") << std::endl;
+            std::cout << GlobalsBlock::getSource();
+            return true;
+        }
+        return false;
+    },
+    "globals_ubo[,on|off|<file>]", "share time, resolution, mouse, camera and light uniforms through one std140 block. <file> saves the block to #include it"));
+
+    _commands.push_back(Command("export_offscreen", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 2) {
+            exportOffscreen = (values[1] == "on");
+            if (values.size() >= 3)
+                exportPreview = vera::toFloat(values[2]);
+            return true;
+        }
+        else {
+            std::cout << (exportOffscreen? "on" : "off") << "," << exportPreview << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "export_offscreen[,on|off[,<preview_secs>]]", "render sequences and recordings as fast as possible without UI, swap or vsync, showing a preview every <preview_secs> (0 for none)"));
+
+    _commands.push_back(Command("stream_out", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 2) {
+            if (values[1] == "off") {
+                m_record_stream.close();
+                return true;
+            }
+            return m_record_stream.open(values[1], toFrameStreamFormat( (values.size() >= 3)? values[2] : "y4m" ));
+        }
+        else {
+            if (m_record_stream.isOpen())
+                std::cout << m_record_stream.getPath() << "," << toString(m_record_stream.getFormat()) << std::endl;
+            else
+                std::cout << "off" << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "stream_out[,off|<file>[,y4m|raw]]", "stream the frames of sequences and recordings to a file or fifo as Y4M or raw RGBA (each frame after a 32 byte header, see tools/frameStream.h), - is stdout"));
+
+    _commands.push_back(Command("capture_sinks", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 2) {
+            captureSinks.clear();
+            for (size_t i = 1; i < values.size(); i++)
+                if (values[i] != "none")
+                    captureSinks.push_back(values[i]);
+            return true;
+        }
+        else {
+            for (size_t i = 0; i < captureSinks.size(); i++)
+                std::cout << ((i > 0)? "," : "") << captureSinks[i];
+            std::cout << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "capture_sinks[,none|<format>[,<format>...]]", "get or set extra image formats (png, tga, hdr, exr...) saved from the same frames while recording a video or a sequence"));
+
+    _commands.push_back(Command("capture_aovs", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values[0] != "capture_aovs")
+            return false;
+
+        if (values.size() >= 2) {
+            captureAovs.clear();
+            for (size_t i = 1; i < values.size(); i++)
+                if (values[i] != "none")
+                    captureAovs.push_back(values[i]);
+            return true;
+        }
+        else {
+            for (size_t i = 0; i < captureAovs.size(); i++)
+                std::cout << ((i > 0)? "," : "") << captureAovs[i];
+            std::cout << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "capture_aovs[,none|<pass>[,<pass>...]]", "get or set the render passes of 3D scenes (depth, normal, position, buffer<N>) saved next to screenshots and sequence frames as <frame>.<pass>.exr"));
+
+    _commands.push_back(Command("capture_aovs_format", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            captureAovsFormat = (values[1] == "npy")? "npy" : "exr";
+            return true;
+        }
+        else {
+            std::cout << captureAovsFormat << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "capture_aovs_format[,exr|npy]", "get or set if render passes are saved as 32 bits float EXR or NumPy arrays"));
+
+    _commands.push_back(Command("sequence_encoder", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 2) {
+            m_record_encoder.enabled = (values[1] != "default");
+            if (values.size() >= 3)
+                m_record_encoder.level = vera::toInt(values[2]);
+            if (values.size() >= 4)
+                m_record_encoder.filter = toPngFilter(values[3]);
+            if (values.size() >= 5)
+                m_record_encoder.strips = vera::toInt(values[4]);
+            return true;
+        }
+        else {
+            std::cout << (m_record_encoder.enabled? "fast" : "default") << "," << m_record_encoder.level << "," << toString(m_record_encoder.filter) << "," << m_record_encoder.strips << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "sequence_encoder[,default|fast[,<level>[,none|sub|up|adaptive[,<strips>]]]]", "get or set how png/tga frames are encoded: zlib level, row filter and how many row strips of a frame are deflated in parallel (0 is auto)"));
+
+    _commands.push_back(Command("exr_compression", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            m_record_encoder.exr = toExrCompression(values[1]);
+            return true;
+        }
+        else {
+            std::cout << toString(m_record_encoder.exr) << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "exr_compression[,none|zips|zip]", "get or set the compression of half float exr frames"));
+
+    _commands.push_back(Command("subframes", [&](const std::string& _line) {
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 2) {
+            setRecordingSubframes( vera::toInt(values[1]), (values.size() >= 3)? vera::toFloat(values[2]) : getRecordingShutter() );
+            if (values.size() >= 4)
+                m_record_jitter = vera::toFloat(values[3]);
+            return true;
+        }
+        else {
+            std::cout << getRecordingSubframes() << "," << getRecordingShutter() << "," << m_record_jitter << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "subframes[,<count>[,<shutter>[,<jitter>]]]", "get or set how many sub-frames are averaged into each recorded frame, the fraction of the frame the shutter stays open (motion blur) and the sub-pixel jitter in pixels (0 is off)"));
+
     #if defined(SUPPORT_MULTITHREAD_RECORDING)
     _commands.push_back(Command("max_mem_in_queue", [&](const std::string & line) {
         std::vector<std::string> values = vera::split(line,',');
         if (values.size() == 2) {
-            m_max_mem_in_queue = std::stoll(values[1]);
+            m_record_budget.setLimit( std::stoll(values[1]) );
         }
         else {
-            std::cout << m_max_mem_in_queue.load() << std::endl;
+            std::cout << m_record_budget.getLimit() << std::endl;
         }
         return false;
     }, "max_mem_in_queue[,<bytes>]", "set the maximum amount of memory used by a queue to export images to disk"));
+
+    _commands.push_back(Command("save_queue", [&](const std::string & line) {
+        std::cout << m_record_budget.getJobs() << "," << m_record_budget.getInFlight() << "," << m_record_budget.getLimit() << std::endl;
+        return true;
+    }, "save_queue", "print how many frames are waiting to be saved, the bytes they hold and the memory limit"));
     #endif
 
     if (vert_index != -1 || geom_index != -1)
@@ -1041,6 +1376,8 @@ void Sandbox::loadModel(vera::Model* _model) {
 }
 
 void Sandbox::addDefine(const std::string &_define, const std::string &_value) {
+    uniforms.flagProgramsChange();
+
     for (int i = 0; i < m_buffers_total; i++)
         m_buffers_shaders[i].addDefine(_define, _value);
 
@@ -1058,6 +1395,8 @@ void Sandbox::addDefine(const std::string &_define, const std::string &_value) {
 }
 
 void Sandbox::delDefine(const std::string &_define) {
+    uniforms.flagProgramsChange();
+
     for (int i = 0; i < m_buffers_total; i++)
         m_buffers_shaders[i].delDefine(_define);
 
@@ -1094,6 +1433,7 @@ bool Sandbox::haveChange() {
     return  m_change ||
             isRecording() ||
             screenshotFile != "" ||
+            tiledFile != "" ||
             m_sceneRender.haveChange() ||
             uniforms.haveChange();
 }
@@ -1336,6 +1676,9 @@ void Sandbox::_updateBuffers() {
 void Sandbox::_renderBuffers() {
     glDisable(GL_BLEND);
 
+    // passes keep binding the same textures to the same units, skip what is already there
+    uniforms.textureUnits.begin();
+
     bool reset_viewport = false;
     for (size_t i = 0; i < uniforms.buffers.size(); i++) {
         TRACK_BEGIN("render:buffer" + vera::toString(i))
@@ -1347,12 +1690,7 @@ void Sandbox::_renderBuffers() {
         m_buffers_shaders[i].use();
 
         // Pass textures for the other buffers
-        for (size_t j = 0; j < uniforms.buffers.size(); j++)
-            if (i != j)
-                m_buffers_shaders[i].setUniformTexture("u_buffer" + vera::toString(j), &uniforms.buffers[j] );
-
-        for (size_t j = 0; j < uniforms.doubleBuffers.size(); j++)
-                m_buffers_shaders[i].setUniformTexture("u_doubleBuffer" + vera::toString(j), uniforms.doubleBuffers[j].src );
+        uniforms.feedBuffersTo( &m_buffers_shaders[i], i );
 
         // Update uniforms and textures
         uniforms.feedTo( &m_buffers_shaders[i], true, false);
@@ -1374,11 +1712,7 @@ void Sandbox::_renderBuffers() {
         m_doubleBuffers_shaders[i].use();
 
         // Pass textures for the other buffers
-        for (size_t j = 0; j < uniforms.buffers.size(); j++)
-            m_doubleBuffers_shaders[i].setUniformTexture("u_buffer" + vera::toString(j), &uniforms.buffers[j] );
-
-        for (size_t j = 0; j < uniforms.doubleBuffers.size(); j++)
-            m_doubleBuffers_shaders[i].setUniformTexture("u_doubleBuffer" + vera::toString(j), uniforms.doubleBuffers[j].src );
+        uniforms.feedBuffersTo( &m_doubleBuffers_shaders[i] );
 
         // Update uniforms and textures
         uniforms.feedTo( &m_doubleBuffers_shaders[i], true, false);
@@ -1412,6 +1746,7 @@ void Sandbox::_renderBuffers() {
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         uniforms.pyramids[i].process(&m_pyramid_fbos[i]);
+        uniforms.textureUnits.invalidate();
 
         TRACK_END("render:convolution_pyramid" + vera::toString(i))
     }
@@ -1421,6 +1756,8 @@ void Sandbox::_renderBuffers() {
         reset_viewport = true;
     #endif
 
+    uniforms.textureUnits.end();
+
     if (reset_viewport)
         glViewport(0.0f, 0.0f, vera::getWindowWidth(), vera::getWindowHeight());
     
@@ -1431,11 +1768,80 @@ void Sandbox::_renderBuffers() {
 void Sandbox::renderPrep() {
     TRACK_BEGIN("render")
 
+    // RESUME
+    // -----------------------------------------------
+    // frames a previous run already saved are skipped before anything gets updated for them
+    if (isRecording() && !recordingPipe() && m_record_journal.isResuming()) {
+        int skipped = 0;
+        while (isRecording()) {
+            std::string file = _sequenceFile();
+            std::vector<std::string> files = _captureFiles(file);
+            std::vector<std::string> aovs = _captureAovFiles(file);
+            files.insert(files.end(), aovs.begin(), aovs.end());
+            if (!m_record_journal.isComplete(files))
+                break;
+
+            recordingFrameAdded();
+            skipped++;
+        }
+        if (skipped > 0 && verbose)
+            std::cout << "Skipped " << skipped << " frames already in " << m_record_journal.getPath() << std::endl;
+    }
+
+    // OFFSCREEN EXPORT
+    // -----------------------------------------------
+    // recorded frames only reach the window now and then as a preview
+    m_present = true;
+    if (exportOffscreen && isRecording()) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        m_present = exportPreview > 0.0f && std::chrono::duration<float>(now - m_export_preview_last).count() >= exportPreview;
+        if (m_present)
+            m_export_preview_last = now;
+    }
+
     // UPDATE STREAMING TEXTURES
     // -----------------------------------------------
     if (m_initialized)
         uniforms.update();
 
+    // UNIFORMS FROM THE CONSOLE/OSC
+    // -----------------------------------------------
+    uniforms.ingest();
+
+    // AUTOMATION
+    // -----------------------------------------------
+    // live changes are keyed on u_time, exports replay them from the recording time
+    {
+        std::lock_guard<std::mutex> lock(m_automation_mutex);
+        if (m_automation.isPlaying()) {
+            float time = isRecording()? getRecordingTime() : _getTime();
+            m_automation.apply(time, [this](const std::string& _name, const std::array<float, 4>& _value, size_t _size, bool _int) {
+                if (_size == 1)
+                    uniforms.set(_name, _value[0]);
+                else if (_size == 2)
+                    uniforms.set(_name, _value[0], _value[1]);
+                else if (_size == 3)
+                    uniforms.set(_name, _value[0], _value[1], _value[2]);
+                else
+                    uniforms.set(_name, _value[0], _value[1], _value[2], _value[3]);
+            });
+        }
+        else if (m_automation.isRecording() && !isRecording()) {
+            // the first frame keys every uniform, later ones only what changed
+            float time = _getTime();
+            bool first = m_automation.getKeys() == 0;
+            for (UniformDataMap::iterator it = uniforms.data.begin(); it != uniforms.data.end(); ++it)
+                if ((it->second.change || first) && it->second.size > 0)
+                    m_automation.capture(it->first, it->second.value.data(), it->second.size, it->second.bInt, time, m_frame);
+        }
+    }
+
+    // GLOBALS BLOCK
+    // -----------------------------------------------
+    // one upload for every pass instead of setting them on each program
+    if (uniforms.globalsBlock.isEnabled())
+        _updateGlobals();
+
     // BUFFERS
     // -----------------------------------------------
     if (m_update_buffers)
@@ -1451,13 +1857,47 @@ void Sandbox::renderPrep() {
     if (uniforms.models.size() > 0)
         m_sceneRender.renderShadowMap(uniforms);
     
+    // SUB-FRAME JITTER
+    // -----------------------------------------------
+    m_record_jitter_offset = glm::vec2(0.0);
+    if (isRecording() && getRecordingSubframes() > 1 && m_record_jitter > 0.0f) {
+        int index = getRecordingSubframe() + 1;
+        m_record_jitter_offset = (glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f) * m_record_jitter;
+
+        // shift the projection by the same amount of pixels, restored on renderDone
+        if (uniforms.models.size() > 0 && uniforms.activeCamera) {
+            glm::mat4 shift(1.0);
+            shift[3][0] = -2.0f * m_record_jitter_offset.x / float(vera::getWindowWidth());
+            shift[3][1] = -2.0f * m_record_jitter_offset.y / float(vera::getWindowHeight());
+            m_record_jitter_camera = true;
+            m_record_jitter_projection = uniforms.activeCamera->getProjectionType();
+            uniforms.activeCamera->setProjection(shift * uniforms.activeCamera->getProjectionMatrix());
+        }
+    }
+
     // MAIN SCENE
     // ----------------------------------------------- < main scene start
-    if (screenshotFile != "" || isRecording() )
-        if (!m_record_fbo.isAllocated())
-            m_record_fbo.allocate(vera::getWindowWidth(), vera::getWindowHeight(), vera::COLOR_TEXTURE_DEPTH_BUFFER);
+    if (screenshotFile != "" || isRecording() ) {
+        // hdr and exr frames need a float target to keep values above 1.0
+        bool floatTarget = _captureFloat();
+        if (!m_record_fbo.isAllocated() || m_record_fbo_float != floatTarget) {
+            m_record_fbo.allocate(vera::getWindowWidth(), vera::getWindowHeight(), floatTarget? vera::COLOR_FLOAT_TEXTURE_DEPTH_BUFFER : vera::COLOR_TEXTURE_DEPTH_BUFFER);
+            m_record_fbo_float = floatTarget;
+        }
+    }
 
-    if (m_postprocessing || m_plot == PLOT_LUMA || m_plot == PLOT_RGB || m_plot == PLOT_RED || m_plot == PLOT_GREEN || m_plot == PLOT_BLUE ) {
+    // warm up the frame pools as a recording starts (or the readback depth changes)
+    if (isRecording()) {
+        if (!m_record_pooled.exchange(true))
+            _allocateRecordPools(vera::getWindowWidth(), vera::getWindowHeight());
+    }
+    else
+        m_record_pooled = false;
+
+    // saving render passes needs them rendered, like post-processing does
+    m_record_aovs = captureAovs.size() > 0 && uniforms.models.size() > 0 && (screenshotFile != "" || isRecording());
+
+    if (m_postprocessing || m_record_aovs || m_plot == PLOT_LUMA || m_plot == PLOT_RGB || m_plot == PLOT_RED || m_plot == PLOT_GREEN || m_plot == PLOT_BLUE ) {
         if (uniforms.functions["u_sceneNormal"].present)
             m_sceneRender.renderNormalBuffer(uniforms);
 
@@ -1490,6 +1930,8 @@ void Sandbox::render() {
                 uniforms.activeCamera->setVirtualOffset(5.0f, viewIndex, quilt.totalViews);
                 uniforms.set("u_tile", float(quilt.columns), float(quilt.rows), float(quilt.totalViews));
                 uniforms.set("u_viewport", float(viewport.x), float(viewport.y), float(viewport.z), float(viewport.w));
+                if (uniforms.globalsBlock.isEnabled())
+                    _updateGlobals();
 
                 // Update Uniforms and textures variables
                 uniforms.feedTo( &m_canvas_shader );
@@ -1524,6 +1966,8 @@ void Sandbox::render() {
 
                 uniforms.set("u_tile", float(quilt.columns), float(quilt.rows), float(quilt.totalViews));
                 uniforms.set("u_viewport", float(viewport.x), float(viewport.y), float(viewport.z), float(viewport.w));
+                if (uniforms.globalsBlock.isEnabled())
+                    _updateGlobals();
 
                 m_sceneRender.render(uniforms);
 
@@ -1567,7 +2011,7 @@ void Sandbox::renderPost() {
 
         TRACK_END("render:postprocessing")
     }
-    else if (m_plot == PLOT_RGB || m_plot == PLOT_RED || m_plot == PLOT_GREEN || m_plot == PLOT_BLUE || m_plot == PLOT_LUMA) {
+    else if (m_record_aovs || m_plot == PLOT_RGB || m_plot == PLOT_RED || m_plot == PLOT_GREEN || m_plot == PLOT_BLUE || m_plot == PLOT_LUMA) {
         m_sceneRender.renderFbo.unbind();
 
         if (screenshotFile != "" || isRecording())
@@ -1579,7 +2023,8 @@ void Sandbox::renderPost() {
     if (screenshotFile != "" || isRecording()) {
         m_record_fbo.unbind();
 
-        vera::image(m_record_fbo);
+        if (m_present)
+            vera::image(m_record_fbo);
     }
 
     TRACK_END("render")
@@ -1804,8 +2249,34 @@ void Sandbox::renderDone() {
 
     // RECORD
     if (isRecording()) {
-        onScreenshot( vera::toString( getRecordingCount() , 0, 5, '0') + ".png");
-        recordingFrameAdded();
+        if (m_record_jitter_camera) {
+            uniforms.activeCamera->setProjection( m_record_jitter_projection );
+            m_record_jitter_camera = false;
+        }
+
+        // sub-frames are added up until the last one completes the frame
+        bool ready = true;
+        if (getRecordingSubframes() > 1 && !isRecordingFrameComplete()) {
+            _accumulateSubframe();
+            recordingSubframeAdded();
+            ready = isRecordingFrameComplete();
+        }
+
+        // while the encoder or the save threads catch up hold the clock, 
+        // the same frame will be rendered again
+        ready = ready && recordingPipeReady();
+        #if defined(SUPPORT_MULTITHREAD_RECORDING)
+        // the next frame reads as much as the last one did (all its sinks, passes and planes)
+        size_t bytes = m_record_pbo.getFrameBytes();
+        if (bytes == 0)
+            bytes = (size_t)vera::getWindowWidth() * (size_t)vera::getWindowHeight() * (isFloatFormat(sequenceFormat)? 4 * sizeof(float) : 4);
+        ready = ready && m_record_budget.fits( m_record_pbo.getPendingBytes() + bytes );
+        #endif
+
+        if (ready) {
+            onScreenshot( _sequenceFile() );
+            recordingFrameAdded();
+        }
     }
     // SCREENSHOT 
     else if (screenshotFile != "") {
@@ -1813,6 +2284,11 @@ void Sandbox::renderDone() {
         screenshotFile = "";
     }
 
+    if (tiledFile != "") {
+        onTiledScreenshot(tiledFile, tiledSize.x, tiledSize.y, tileSize);
+        tiledFile = "";
+    }
+
     unflagChange();
 
     if (m_plot != PLOT_OFF)
@@ -1997,64 +2473,465 @@ void Sandbox::onViewportResize(int _newWidth, int _newHeight) {
             m_sceneRender.updateBuffers(uniforms, _newWidth, _newHeight);
     }
 
-    if (screenshotFile != "" || isRecording())
-        m_record_fbo.allocate(_newWidth, _newHeight, vera::COLOR_TEXTURE_DEPTH_BUFFER);
+    if (screenshotFile != "" || isRecording()) {
+        m_record_fbo_float = _captureFloat();
+        m_record_fbo.allocate(_newWidth, _newHeight, m_record_fbo_float? vera::COLOR_FLOAT_TEXTURE_DEPTH_BUFFER : vera::COLOR_TEXTURE_DEPTH_BUFFER);
+
+        // frames of the old size are freed as they come back
+        m_record_pool.clear();
+        m_record_pool_float.clear();
+        m_record_pool_depth.clear();
+        if (isRecording()) {
+            _allocateRecordPools(_newWidth, _newHeight);
+            m_record_pooled = true;
+        }
+    }
 
     flagChange();
 }
 
+// Files saved from a frame: the image file (unless a video is being recorded) and the extra capture sinks
+std::vector<std::string> Sandbox::_captureFiles(const std::string& _file) const {
+    bool video = recordingPipe();
+    std::vector<std::string> files;
+    if (!video && vera::getExt(_file) != "none")
+        files.push_back(_file);
+
+    if (isRecording()) {
+        std::string ext = vera::getExt(_file);
+        std::string basename = _file.substr(0, _file.size() - ext.size() - 1);
+        for (size_t i = 0; i < captureSinks.size(); i++)
+            if (video || captureSinks[i] != ext)
+                files.push_back(basename + "." + captureSinks[i]);
+    }
+    return files;
+}
+
+std::vector<std::string> Sandbox::_captureAovFiles(const std::string& _file) const {
+    std::vector<std::string> files;
+    std::string ext = vera::getExt(_file);
+    std::string basename = _file.substr(0, _file.size() - ext.size() - 1);
+    for (size_t i = 0; i < captureAovs.size(); i++)
+        files.push_back(basename + "." + captureAovs[i] + "." + captureAovsFormat);
+    return files;
+}
+
+vera::Fbo* Sandbox::_captureAovFbo(const std::string& _aov) {
+    vera::Fbo* fbo = nullptr;
+    if (_aov == "depth")
+        fbo = &m_sceneRender.renderFbo;
+    else if (_aov == "normal")
+        fbo = &m_sceneRender.normalFbo;
+    else if (_aov == "position")
+        fbo = &m_sceneRender.positionFbo;
+    else if (_aov.find("buffer") == 0) {
+        size_t index = vera::toInt(_aov.substr(6));
+        if (index < m_sceneRender.buffersFbo.size())
+            fbo = &m_sceneRender.buffersFbo[index];
+    }
+    return (fbo && fbo->isAllocated())? fbo : nullptr;
+}
+
+std::string Sandbox::_sequenceFile() const {
+    int index = sequenceAbsolute? getRecordingFrame() : getRecordingCount();
+    return vera::toString( index , 0, 5, '0') + "." + sequenceFormat;
+}
+
+bool Sandbox::_captureFloat() const {
+    if (screenshotFile != "" && isFloatFormat(screenshotFile))
+        return true;
+
+    if (isRecording()) {
+        if (!recordingPipe() && isFloatFormat(sequenceFormat))
+            return true;
+        for (size_t i = 0; i < captureSinks.size(); i++)
+            if (isFloatFormat(captureSinks[i]))
+                return true;
+    }
+    return false;
+}
+
+// Enough buffers of each shape read by a recorded frame for the frames in flight and the one being saved
+void Sandbox::_allocateRecordPools(int _width, int _height) {
+    size_t count = m_record_pbo.getDepth() + 1;
+    size_t pixels = (size_t)_width * (size_t)_height;
+
+    bool images = false;
+    bool floats = false;
+    std::vector<std::string> files = _captureFiles(_sequenceFile());
+    for (size_t i = 0; i < files.size(); i++) {
+        if (isFloatFormat(files[i]))
+            floats = true;
+        else
+            images = true;
+    }
+
+    // the video, unless it shares the RGBA read of the images
+    if (recordingPipe() && !(recordingPipeRGBA() && images))
+        m_record_pool.allocate(recordingPipeYUV()? getYUV420PackedBytes(_width, _height) : pixels * (recordingPipeRGBA()? 4 : 3), count);
+    if (images)
+        m_record_pool.allocate(pixels * 4, count);
+
+    // render passes are read at the size of the scene buffers, which follow the window
+    size_t aovs = 0;
+    bool depth = false;
+    for (size_t i = 0; i < captureAovs.size() && uniforms.models.size() > 0; i++) {
+        if (captureAovs[i] == "depth")
+            depth = true;
+        else
+            aovs++;
+    }
+
+    if (floats || aovs > 0)
+        m_record_pool_float.allocate(pixels * 4 * sizeof(float), count * ((floats? 1 : 0) + aovs));
+    if (depth)
+        m_record_pool_depth.allocate(pixels * sizeof(float), count);
+}
+
+SharedPixels Sandbox::_shareFrame(FramePool& _pool, Pixels&& _pixels, size_t _bytes) {
+    #if defined(SUPPORT_MULTITHREAD_RECORDING)
+    m_record_budget.reserve(_bytes);
+    #endif
+
+    // once every sink is done with it the frame goes back to the pool
+    FramePool* pool = &_pool;
+    return SharedPixels(_pixels.release(), [this, pool, _bytes](unsigned char* _data) {
+        pool->release(Pixels(_data), _bytes);
+        #if defined(SUPPORT_MULTITHREAD_RECORDING)
+        m_record_budget.release(_bytes);
+        #endif
+    });
+}
+
+void Sandbox::_accumulateSubframe() {
+    int width = vera::getWindowWidth();
+    int height = vera::getWindowHeight();
+    if (!m_record_accum_fbo.isAllocated() || m_record_accum_fbo.getWidth() != width || m_record_accum_fbo.getHeight() != height)
+        m_record_accum_fbo.allocate(width, height, vera::COLOR_FLOAT_TEXTURE);
+
+    if (!m_record_accum_shader.isLoaded())
+        m_record_accum_shader.setSource(accumulate_frag, vera::getDefaultSrc(vera::VERT_BILLBOARD));
+
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLint blendSrc, blendDst;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+
+    m_record_accum_fbo.bind();
+    if (getRecordingSubframe() == 0) {
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    m_record_accum_shader.use();
+    m_record_accum_shader.setUniform("u_resolution", float(width), float(height));
+    m_record_accum_shader.setUniform("u_weight", 1.0f / float(getRecordingSubframes()));
+    m_record_accum_shader.setUniformTexture("u_tex0", &m_record_fbo, 0);
+    vera::getBillboard()->render( &m_record_accum_shader );
+    m_record_accum_fbo.unbind();
+
+    glBlendFunc(blendSrc, blendDst);
+    if (!blend)
+        glDisable(GL_BLEND);
+}
+
+float Sandbox::_getTime() const {
+    if (m_time_held)
+        return m_time_hold;
+    return float(vera::getTime()) - m_time_offset;
+}
+
+void Sandbox::holdTime(bool _hold) {
+    if (_hold && !m_time_held)
+        m_time_hold = float(vera::getTime()) - m_time_offset;
+    else if (!_hold && m_time_held)
+        m_time_offset = float(vera::getTime()) - m_time_hold;
+    m_time_held = _hold;
+}
+
+#if defined(SUPPORT_MULTITHREAD_RECORDING)
+void Sandbox::_submitSave(const std::shared_ptr<Job>& _job) {
+    {
+        std::lock_guard<std::mutex> lock(m_save_mutex);
+        m_save_pending++;
+    }
+
+    m_save_threads.Submit([this, _job]() {
+        (*_job)();
+
+        std::lock_guard<std::mutex> lock(m_save_mutex);
+        if (--m_save_pending == 0)
+            m_save_done.notify_all();
+    });
+}
+#endif
+
+void Sandbox::flushCapture() {
+    if ( !vera::isGL() )
+        return;
+
+    m_record_pbo.flush();
+    m_record_stream.flush();
+}
+
+void Sandbox::waitSaves() {
+    #if defined(SUPPORT_MULTITHREAD_RECORDING)
+    std::unique_lock<std::mutex> lock(m_save_mutex);
+    m_save_done.wait(lock, [this]{ return m_save_pending == 0; });
+    #endif
+}
+
+void Sandbox::_updateGlobals() {
+    GlobalsData& globals = uniforms.globalsBlock.data;
+
+    globals.date = vera::getDate();
+    if (m_tile_resolution.x > 0.0)
+        globals.resolution = m_tile_resolution;
+    else
+        globals.resolution = glm::vec2(vera::getWindowWidth(), vera::getWindowHeight());
+    globals.mouse = glm::vec2(vera::getMouseX(), vera::getMouseY());
+
+    if (isRecording()) {
+        globals.time = getRecordingTime();
+        globals.delta = getRecordingDelta();
+        globals.frame = getRecordingFrame();
+    }
+    else {
+        globals.time = _getTime();
+        globals.delta = float(vera::getDelta());
+        globals.frame = (int)m_frame;
+    }
+
+    vera::Camera* camera = uniforms.activeCamera;
+    if (camera) {
+        globals.camera = -camera->getPosition();
+        globals.cameraDistance = camera->getDistance();
+        globals.cameraNearClip = camera->getNearClip();
+        globals.cameraFarClip = camera->getFarClip();
+        globals.cameraExposure = camera->getExposure();
+        globals.cameraEv100 = camera->getEv100();
+        globals.iblLuminance = 30000.0f * camera->getExposure();
+        globals.viewMatrix = camera->getViewMatrix();
+        globals.inverseViewMatrix = camera->getInverseViewMatrix();
+        globals.projectionMatrix = camera->getProjectionMatrix();
+        globals.inverseProjectionMatrix = camera->getInverseProjectionMatrix();
+        glm::mat3 normalMatrix = camera->getNormalMatrix();
+        for (int i = 0; i < 3; i++)
+            globals.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+    }
+
+    // only a single light goes by the u_light* names
+    if (uniforms.lights.size() == 1) {
+        vera::Light* light = uniforms.lights.begin()->second;
+        globals.light = light->getPosition();
+        globals.lightIntensity = light->intensity;
+        globals.lightColor = glm::vec3(light->color);
+        globals.lightFalloff = light->falloff;
+        globals.lightDirection = glm::vec3(light->direction);
+        globals.lightMatrix = light->getBiasMVPMatrix();
+    }
+
+    uniforms.globalsBlock.update();
+}
+
 void Sandbox::onScreenshot(std::string _file) {
 
     if (_file != "" && vera::isGL()) {
         TRACK_BEGIN("screenshot")
 
-        glBindFramebuffer(GL_FRAMEBUFFER, m_record_fbo.getId());
+        // recordings with sub-frames save their average
+        vera::Fbo* source = &m_record_fbo;
+        if (isRecording() && getRecordingSubframes() > 1 && m_record_accum_fbo.isAllocated())
+            source = &m_record_accum_fbo;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, source->getId());
 
-        if (vera::getExt(_file) == "hdr") {
-            float* pixels = new float[vera::getWindowWidth() * vera::getWindowHeight()*4];
-            glReadPixels(0, 0, vera::getWindowWidth(), vera::getWindowHeight(), GL_RGBA, GL_FLOAT, pixels);
-            vera::savePixelsHDR(_file, pixels, vera::getWindowWidth(), vera::getWindowHeight());
+        bool video = recordingPipe();
+        std::vector<std::string> files = _captureFiles(_file);
+
+        // saved frames of a sequence go to the journal, if there is one
+        RecordingJournal* journal = (isRecording() && m_record_journal.isOpen())? &m_record_journal : nullptr;
+
+        std::vector<std::string> images;
+        std::vector<std::string> floats;
+        for (size_t i = 0; i < files.size(); i++) {
+            if (isFloatFormat(files[i]))
+                floats.push_back(files[i]);
+            else
+                images.push_back(files[i]);
+        }
+
+        if (floats.size() > 0) {
+            // one float readback for all the hdr/exr sinks, converted and saved by the save threads
+            PixelsRequest request(vera::getWindowWidth(), vera::getWindowHeight(), GL_RGBA, GL_FLOAT);
+            m_record_pbo.read(request, [this, floats, journal](const PixelsRequest& _request, const void* _data) {
+                Pixels pixels = m_record_pool_float.acquire( _request.getBytes() );
+                memcpy(pixels.get(), _data, _request.getBytes());
+                SharedPixels frame = _shareFrame(m_record_pool_float, std::move(pixels), _request.getBytes());
+
+                for (size_t i = 0; i < floats.size(); i++) {
+                    #if defined(SUPPORT_MULTITHREAD_RECORDING)
+                    _submitSave( std::make_shared<Job>(floats[i], _request.width, _request.height, frame, m_record_encoder, journal) );
+                    #else
+                    Job saver(floats[i], _request.width, _request.height, frame, m_record_encoder, journal);
+                    saver();
+                    #endif
+                }
+            });
+        }
+
+        // render passes go next to the frame at full precision, depth as the distance to the camera
+        int aovs = 0;
+        std::vector<std::string> aovFiles = _captureAovFiles(_file);
+        for (size_t i = 0; i < aovFiles.size() && m_record_aovs; i++) {
+            vera::Fbo* fbo = _captureAovFbo(captureAovs[i]);
+            if (fbo == nullptr) {
+                if (verbose)
+                    std::cerr << captureAovs[i] << " is not rendered, the shader needs to use it (u_scene" << captureAovs[i] << ")" << std::endl;
+                continue;
+            }
+
+            bool depth = captureAovs[i] == "depth";
+            float zNear = uniforms.activeCamera? uniforms.activeCamera->getNearClip() : 0.0f;
+            float zFar = uniforms.activeCamera? uniforms.activeCamera->getFarClip() : 1.0f;
+            bool ortho = uniforms.activeCamera && uniforms.activeCamera->getProjectionType() == vera::ProjectionType::ORTHO;
+            std::string file = aovFiles[i];
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo->getId());
+            PixelsRequest request(fbo->getWidth(), fbo->getHeight(), depth? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT);
+            m_record_pbo.read(request, [this, file, depth, zNear, zFar, ortho, journal](const PixelsRequest& _request, const void* _data) {
+                FramePool& pool = depth? m_record_pool_depth : m_record_pool_float;
+                Pixels pixels = pool.acquire( _request.getBytes() );
+                memcpy(pixels.get(), _data, _request.getBytes());
+
+                if (depth) {
+                    float* z = reinterpret_cast<float*>(pixels.get());
+                    size_t total = (size_t)_request.width * _request.height;
+                    for (size_t j = 0; j < total; j++)
+                        z[j] = ortho? zNear + z[j] * (zFar - zNear) : (2.0f * zNear * zFar) / (zFar + zNear - (z[j] * 2.0f - 1.0f) * (zFar - zNear));
+                }
+
+                SharedPixels frame = _shareFrame(pool, std::move(pixels), _request.getBytes());
+
+                #if defined(SUPPORT_MULTITHREAD_RECORDING)
+                _submitSave( std::make_shared<Job>(file, _request.width, _request.height, frame, m_record_encoder, journal, depth? 1 : 4) );
+                #else
+                Job saver(file, _request.width, _request.height, frame, m_record_encoder, journal, depth? 1 : 4);
+                saver();
+                #endif
+            });
+            aovs++;
         }
+        glBindFramebuffer(GL_FRAMEBUFFER, source->getId());
+
+        // the video can share the RGBA frame with the images if it was opened for it
+        bool shared = video && recordingPipeRGBA();
+
+        // frames of a recording also go down the stream, Y4M ones as the YUV420 planes packed on the GPU
+        int width = vera::getWindowWidth();
+        int height = vera::getWindowHeight();
+        bool stream = isRecording() && m_record_stream.isOpen();
+        bool streamYUV = stream && m_record_stream.getFormat() == STREAM_Y4M;
+        bool streamRGBA = stream && m_record_stream.getFormat() == STREAM_RGBA;
+        float streamFps = stream? 1.0f / getRecordingDelta() : 0.0f;
+
+        // sinks the frame goes to, each one reports when it's done with it (see progress.h)
+        if (isRecording())
+            progressFrameOutputs( (int)(images.size() + floats.size()) + aovs + (video? 1 : 0) + (stream? 1 : 0) );
+
         #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
-        else if (recordingPipe()) {
-            int width = vera::getWindowWidth();
-            int height = vera::getWindowHeight();
-            auto pixels = std::unique_ptr<unsigned char[]>(new unsigned char [width * height * 3]);
-            glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.get());
-            recordingPipeFrame( std::move(pixels) );
+        if (video && !(shared && images.size() > 0)) {
+            PixelsRequest request(width, height, recordingPipeRGBA()? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE);
+
+            // flip and pack the frame as YUV420 on the GPU, halving what has to be read back
+            bool yuv = recordingPipeYUV();
+            if (yuv)
+                request = _packYUV420(source);
+
+            // a Y4M stream takes the same planes
+            bool toStream = yuv && streamYUV;
+            m_record_pbo.read(request, [this, toStream, width, height, streamFps](const PixelsRequest& _request, const void* _data) {
+                if (toStream)
+                    progressOutputDone( m_record_stream.write((const unsigned char*)_data, width, height, streamFps) );
+
+                Pixels pixels = m_record_pool.acquire( _request.getBytes() );
+                memcpy(pixels.get(), _data, _request.getBytes());
+                recordingPipeFrame( _shareFrame(m_record_pool, std::move(pixels), _request.getBytes()) );
+            });
+
+            if (yuv) {
+                m_record_yuv_fbo.unbind();
+                glBindFramebuffer(GL_FRAMEBUFFER, source->getId());
+            }
+
+            streamYUV = streamYUV && !toStream;
+            shared = false;
         }
         #endif
-        else {
-            int width = vera::getWindowWidth();
-            int height = vera::getWindowHeight();
-            auto pixels = std::unique_ptr<unsigned char[]>(new unsigned char [width * height * 4]);
-            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.get());
 
-            #if defined(SUPPORT_MULTITHREAD_RECORDING)
-            
-            std::shared_ptr<Job> saverPtr = std::make_shared<Job>(std::move(_file), width, height, std::move(pixels), m_task_count, m_max_mem_in_queue);
-            /** In the case that we render faster than we can safe frames, more and more frames
-             * have to be stored temporary in the save queue. That means that more and more ram is used.
-             * If to much is memory is used, we save the current frame directly to prevent that the system
-             * is running out of memory. Otherwise we put the frame in to the thread queue, so that we can utilize
-             * multilple cpu cores */
-            if (m_max_mem_in_queue <= 0) {
-                Job& saver = *saverPtr;
-                saver();
-            }
-            else {
-                auto func = [saverPtr]() {
-                    Job& saver = *saverPtr;
+        if (streamYUV) {
+            PixelsRequest request = _packYUV420(source);
+            m_record_pbo.read(request, [this, width, height, streamFps](const PixelsRequest& _request, const void* _data) {
+                progressOutputDone( m_record_stream.write((const unsigned char*)_data, width, height, streamFps) );
+            });
+
+            m_record_yuv_fbo.unbind();
+            glBindFramebuffer(GL_FRAMEBUFFER, source->getId());
+        }
+
+        // the shared memory ring gets the frame straight from the readback, the number and time are the ones rendered now
+        bool publish = m_record_shm.isOpen();
+        int64_t frameIndex = isRecording()? getRecordingFrame() : (int64_t)m_frame;
+        double frameTime = isRecording()? getRecordingTime() : _getTime();
+
+        if (images.size() > 0 || publish || streamRGBA) {
+            // one readback for all the image sinks (and the video, when it takes RGBA)
+            PixelsRequest request(width, height, GL_RGBA, GL_UNSIGNED_BYTE);
+            m_record_pbo.read(request, [this, images, shared, journal, publish, frameIndex, frameTime, streamRGBA, streamFps](const PixelsRequest& _request, const void* _data) {
+                int width = _request.width;
+                int height = _request.height;
+
+                if (publish)
+                    m_record_shm.publish(_data, width, height, SHM_FORMAT_RGBA8, frameIndex, frameTime);
+
+                if (streamRGBA)
+                    progressOutputDone( m_record_stream.write((const unsigned char*)_data, width, height, streamFps) );
+
+                if (images.size() == 0 && !shared)
+                    return;
+
+                /** In the case that we render faster than we can safe frames, more and more frames
+                 * have to be stored temporary in the save queue. That means that more and more ram is used.
+                 * Recordings hold their clock before getting here (see renderDone), so this never waits
+                 * for the save threads on the GL thread. Frames are never encoded on the render thread */
+                Pixels pixels = m_record_pool.acquire( _request.getBytes() );
+                memcpy(pixels.get(), _data, _request.getBytes());
+                SharedPixels frame = _shareFrame(m_record_pool, std::move(pixels), _request.getBytes());
+
+                #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
+                if (shared)
+                    recordingPipeFrame( frame );
+                #endif
+
+                for (size_t i = 0; i < images.size(); i++) {
+                    #if defined(SUPPORT_MULTITHREAD_RECORDING)
+                    _submitSave( std::make_shared<Job>(images[i], width, height, frame, m_record_encoder, journal) );
+                    #else
+                    Job saver(images[i], width, height, frame, m_record_encoder, journal);
                     saver();
-                };
-                m_save_threads.Submit(std::move(func));
-            }
-            #else
+                    #endif
+                }
+            });
+        }
 
-            vera::savePixels(_file, pixels.get(), width, height);
+        // all the reads above come back together, N-1 frames later
+        m_record_pbo.endFrame();
 
-            #endif
-        }
+        // Single screenshots and the last frame of a recording can't wait for more frames to come
+        if ( !isRecording() || isRecordingLastFrame() )
+            flushCapture();
     
         if ( !isRecording() )
             std::cout << "Screenshot saved to " << _file << std::endl;
@@ -2065,6 +2942,138 @@ void Sandbox::onScreenshot(std::string _file) {
     }
 }
 
+PixelsRequest Sandbox::_packYUV420(vera::Fbo* _source) {
+    int width, height;
+    getYUV420PackedSize(vera::getWindowWidth(), vera::getWindowHeight(), width, height);
+    if (!m_record_yuv_fbo.isAllocated() || m_record_yuv_fbo.getWidth() != width || m_record_yuv_fbo.getHeight() != height)
+        m_record_yuv_fbo.allocate(width, height, vera::COLOR_TEXTURE);
+
+    if (!m_record_yuv_shader.isLoaded())
+        m_record_yuv_shader.setSource(yuv420_frag, vera::getDefaultSrc(vera::VERT_BILLBOARD));
+
+    // stays bound for the readback, the caller unbinds it
+    m_record_yuv_fbo.bind();
+    m_record_yuv_shader.use();
+    m_record_yuv_shader.setUniform("u_resolution", float(vera::getWindowWidth()), float(vera::getWindowHeight()));
+    m_record_yuv_shader.setUniformTexture("u_tex0", _source, 0);
+    vera::getBillboard()->render( &m_record_yuv_shader );
+
+    return PixelsRequest(width, height, GL_RGBA, GL_UNSIGNED_BYTE);
+}
+
+void Sandbox::onTiledScreenshot(std::string _file, int _width, int _height, int _tileSize) {
+    if (_file == "" || _width <= 0 || _height <= 0 || !vera::isGL())
+        return;
+
+    if (quilt >= 0) {
+        std::cerr << "Tiled screenshots of quilts are not supported" << std::endl;
+        return;
+    }
+
+    // buffers and post-processing passes are rendered for the whole window, not per tile
+    if (uniforms.buffers.size() > 0 || uniforms.doubleBuffers.size() > 0 || uniforms.pyramids.size() > 0 || m_sceneRender.buffersFbo.size() > 0) {
+        std::cerr << "Tiled screenshots of shaders with buffers, double buffers or pyramids are not supported" << std::endl;
+        return;
+    }
+
+    if (m_postprocessing) {
+        std::cerr << "Tiled screenshots of shaders with post-processing are not supported" << std::endl;
+        return;
+    }
+
+    // 2D shaders only know which tile they render through u_view2d, without it every tile would be the same
+    if (uniforms.models.size() == 0 && !uniforms.functions["u_view2d"].present) {
+        std::cerr << "Tiled screenshots of 2D shaders need them to place gl_FragCoord with u_view2d" << std::endl;
+        return;
+    }
+
+    TRACK_BEGIN("screenshot:tiled")
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    int tile = (_tileSize > 0)? _tileSize : 2048;
+    if (maxSize > 0)
+        tile = std::min(tile, (int)maxSize);
+    int tileWidth = std::min(tile, _width);
+    int tileHeight = std::min(tile, _height);
+
+    if (!m_tile_fbo.isAllocated() || m_tile_fbo.getWidth() != tileWidth || m_tile_fbo.getHeight() != tileHeight)
+        m_tile_fbo.allocate(tileWidth, tileHeight, vera::COLOR_TEXTURE_DEPTH_BUFFER);
+
+    ImageStreamWriter writer;
+    if (!writer.open(_file, _width, _height, m_record_encoder)) {
+        TRACK_END("screenshot:tiled")
+        return;
+    }
+
+    // Only one row of tiles is kept in memory, it goes to the file once all its tiles are read
+    size_t stride = (size_t)_width * 4;
+    std::vector<unsigned char> band(stride * tileHeight);
+    std::vector<unsigned char> pixels((size_t)tileWidth * tileHeight * 4);
+
+    // 3D scenes are framed for the whole image, each tile renders its own part of the projection
+    vera::Camera* camera = (uniforms.models.size() > 0)? uniforms.activeCamera : nullptr;
+    vera::ProjectionType projection = vera::ProjectionType::PERSPECTIVE;
+    glm::mat4 fullProjection(1.0);
+    if (camera) {
+        projection = camera->getProjectionType();
+        camera->setViewport(_width, _height);
+        fullProjection = camera->getProjectionMatrix();
+    }
+
+    m_tile_resolution = glm::vec2(_width, _height);
+    glm::vec2 tileExtent = glm::vec2(tileWidth, tileHeight);
+
+    // PNG and TGA are written from the top, bands go down while tiles inside them read bottom-up
+    for (int top = 0; top < _height; top += tileHeight) {
+        int rows = std::min(tileHeight, _height - top);
+        int y = _height - top - rows;
+
+        for (int x = 0; x < _width; x += tileWidth) {
+            int cols = std::min(tileWidth, _width - x);
+            m_tile_offset = glm::vec2(x, y);
+
+            if (camera) {
+                // scale and shift the clip space so this tile fills the viewport
+                glm::vec2 scale = m_tile_resolution / tileExtent;
+                glm::vec2 center = (m_tile_offset * 2.0f + tileExtent) / m_tile_resolution - 1.0f;
+                glm::mat4 crop(1.0);
+                crop[0][0] = scale.x;
+                crop[1][1] = scale.y;
+                crop[3][0] = -scale.x * center.x;
+                crop[3][1] = -scale.y * center.y;
+                camera->setProjection(crop * fullProjection);
+            }
+            if (uniforms.globalsBlock.isEnabled())
+                _updateGlobals();
+
+            m_tile_fbo.bind();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            render();
+            glReadPixels(0, 0, cols, rows, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            m_tile_fbo.unbind();
+
+            for (int r = 0; r < rows; r++)
+                memcpy(&band[r * stride + x * 4], &pixels[(size_t)r * cols * 4], cols * 4);
+        }
+
+        writer.write(band.data(), rows);
+    }
+
+    m_tile_resolution = glm::vec2(0.0);
+    m_tile_offset = glm::vec2(0.0);
+    if (camera) {
+        camera->setProjection(projection);
+        camera->setViewport(vera::getWindowWidth(), vera::getWindowHeight());
+    }
+    glViewport(0.0f, 0.0f, vera::getWindowWidth(), vera::getWindowHeight());
+
+    if (writer.close())
+        std::cout << "Screenshot saved to " << _file << " (" << _width << "x" << _height << " in " << tileWidth << "x" << tileHeight << " tiles)" << std::endl;
+
+    TRACK_END("screenshot:tiled")
+}
+
 void Sandbox::onPlot() {
     if ( !vera::isGL() )
         return;
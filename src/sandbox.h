@@ -1,14 +1,28 @@
 #pragma once
 
+#include <mutex>
+#include <chrono>
+
 #if defined(SUPPORT_MULTITHREAD_RECORDING)
 #include <atomic>
+#include <condition_variable>
 #include "thread_pool/thread_pool.hpp"
+#include "tools/memoryBudget.h"
 #endif
 
 #include "sceneRender.h"
 #include "tools/files.h"
+#include "tools/pixelBufferRing.h"
+#include "tools/framePool.h"
+#include "tools/imageEncoder.h"
+#include "tools/journal.h"
+#include "tools/shmSink.h"
+#include "tools/frameStream.h"
+#include "tools/automation.h"
 #include "vera/ops/string.h"
 
+class Job;
+
 enum ShaderType {
     FRAGMENT = 0,
     VERTEX = 1
@@ -56,8 +70,20 @@ public:
     // Getting some data out of Sandbox
     const std::string&  getSource( ShaderType _type ) const;
     SceneRender&        getSceneRender() { return m_sceneRender; }
+    FrameStream&        getFrameStream() { return m_record_stream; }
 
     void                printDependencies( ShaderType _type ) const;
+
+    // u_time stops while held (parameter sweeps) and goes on from there once released
+    void                holdTime( bool _hold );
+    bool                isTimeHeld() const { return m_time_held; }
+
+    // Blocks until every frame handed to the save threads is on disk
+    void                waitSaves();
+
+    // Hands the frames still being read back to their sinks. Recordings cut short
+    // call it before the pipe and the sinks close
+    void                flushCapture();
     
     // Some events
     void                onScroll( float _yoffset );
@@ -65,6 +91,7 @@ public:
     void                onViewportResize( int _newWidth, int _newHeight );
     void                onFileChange( WatchFileList &_files, int _index );
     void                onScreenshot( std::string _file );
+    void                onTiledScreenshot( std::string _file, int _width, int _height, int _tileSize );
     void                onPlot();
    
     // Include folders
@@ -75,6 +102,22 @@ public:
 
     // Screenshot file
     std::string         screenshotFile;
+    std::string         sequenceFormat;
+    bool                sequenceAbsolute;   // name frames by their frame number instead of counting from the first one
+    vera::StringList    captureSinks;
+    vera::StringList    captureAovs;        // render passes of 3D scenes saved next to each frame (depth, normal, position, buffer<N>)
+    std::string         captureAovsFormat;  // exr or npy
+
+    // Sequences and recordings rendered back to back offscreen, without UI or swap. The window
+    // only shows a frame every exportPreview seconds (never when zero)
+    bool                exportOffscreen;
+    float               exportPreview;
+    bool                isPresenting() const { return m_present; }
+
+    // Screenshot bigger than the window (or the GPU textures), rendered by tiles
+    std::string         tiledFile;
+    glm::ivec2          tiledSize;
+    int                 tileSize;
 
     // Quilt/Lenticular
     std::string         lenticular;
@@ -91,6 +134,20 @@ public:
 private:
     void                _updateBuffers();
     void                _renderBuffers();
+    SharedPixels        _shareFrame(FramePool& _pool, Pixels&& _pixels, size_t _bytes);
+    void                _allocateRecordPools(int _width, int _height);
+    bool                _captureFloat() const;
+    std::vector<std::string>    _captureFiles(const std::string& _file) const;
+    std::vector<std::string>    _captureAovFiles(const std::string& _file) const;
+    vera::Fbo*          _captureAovFbo(const std::string& _aov);
+    std::string         _sequenceFile() const;
+    void                _accumulateSubframe();
+    void                _updateGlobals();
+    float               _getTime() const;
+    #if defined(SUPPORT_MULTITHREAD_RECORDING)
+    void                _submitSave(const std::shared_ptr<Job>& _job);
+    #endif
+    PixelsRequest       _packYUV420(vera::Fbo* _source);
 
     // Main Shader
     std::string         m_frag_source;
@@ -135,15 +192,49 @@ private:
 
     // Recording
     vera::Fbo           m_record_fbo;
+    vera::Fbo           m_record_yuv_fbo;
+    vera::Shader        m_record_yuv_shader;
+    vera::Fbo           m_record_accum_fbo;     // average of the sub-frames
+    vera::Shader        m_record_accum_shader;
+    glm::vec2           m_record_jitter_offset; // sub-pixel offset of the current sub-frame
+    float               m_record_jitter;        // in pixels, zero disables it
+    bool                m_record_jitter_camera;
+    vera::ProjectionType    m_record_jitter_projection;
+    PixelBufferRing     m_record_pbo;
+    FramePool           m_record_pool;
+    FramePool           m_record_pool_float;
+    FramePool           m_record_pool_depth;
+    std::atomic<bool>   m_record_pooled;        // the pools are warm for the current recording
+    bool                m_record_aovs;          // the scene goes through its render FBO so its passes can be saved
+    bool                m_record_fbo_float;
+    ImageEncoderSettings    m_record_encoder;
+    RecordingJournal        m_record_journal;
+    ShmSink                 m_record_shm;
+    FrameStream             m_record_stream;
+    bool                    m_present;              // this frame reaches the window
+    std::chrono::steady_clock::time_point   m_export_preview_last;
     #if defined(SUPPORT_MULTITHREAD_RECORDING)
-    std::atomic<int>    m_task_count {0};
-    std::atomic<long long>      m_max_mem_in_queue {0};
+    MemoryBudget                m_record_budget;
     thread_pool::ThreadPool     m_save_threads;
+    std::mutex                  m_save_mutex;
+    std::condition_variable     m_save_done;
+    int                         m_save_pending;     // jobs submitted and not written yet
     #endif
 
+    // Uniform automation, recorded live and replayed while exporting
+    UniformAutomation   m_automation;
+    std::mutex          m_automation_mutex;
+
+    // Tiled screenshots
+    vera::Fbo           m_tile_fbo;
+    glm::vec2           m_tile_resolution;  // size of the whole image, zero when not rendering tiles
+    glm::vec2           m_tile_offset;
+
     // Other state properties
     glm::mat3           m_view2d;
     float               m_time_offset;
+    float               m_time_hold;
+    bool                m_time_held;
     float               m_camera_azimuth;
     float               m_camera_elevation;
     size_t              m_frame;
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+/** Adds a weighted copy of u_tex0 to the bound target (with GL_ONE, GL_ONE blending),
+ *  used to average the sub-frames of a recorded frame into a float FBO **/
+
+const std::string accumulate_frag = R"(
+#ifdef GL_ES
+precision highp float;
+#endif
+
+uniform sampler2D   u_tex0;
+uniform vec2        u_resolution;
+uniform float       u_weight;
+
+void main() {
+    gl_FragColor = texture2D(u_tex0, gl_FragCoord.xy / u_resolution) * u_weight;
+}
+)";
+
+// Low discrepancy sequence used to jitter the sub-frames inside the pixel
+inline float halton(int _index, int _base) {
+    float f = 1.0f;
+    float r = 0.0f;
+    while (_index > 0) {
+        f /= (float)_base;
+        r += f * (float)(_index % _base);
+        _index /= _base;
+    }
+    return r;
+}
@@ -0,0 +1,232 @@
+#include "automation.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#define AUTOMATION_VERSION 1
+
+UniformAutomation::UniformAutomation() : m_interpolation(AUTOMATION_LINEAR), m_recording(false), m_playing(false) {
+}
+
+UniformAutomation::~UniformAutomation() {
+    if (m_recording)
+        stop();
+}
+
+void UniformAutomation::record(const std::string& _file) {
+    clear();
+    m_file = _file;
+    m_recording = true;
+}
+
+void UniformAutomation::capture(const std::string& _name, const float* _value, size_t _size, bool _int, float _time, size_t _frame) {
+    if (!m_recording)
+        return;
+
+    AutomationTrack& track = m_tracks[_name];
+    track.name = _name;
+    track.size = std::min(_size, (size_t)4);
+    track.bInt = _int;
+
+    AutomationKey key;
+    key.time = _time;
+    key.frame = (uint32_t)_frame;
+    for (size_t i = 0; i < 4; i++)
+        key.value[i] = (i < track.size)? _value[i] : 0.0f;
+
+    if (track.keys.size() > 0) {
+        // only what changes, re-sent values don't make keys
+        if (track.keys.back().value == key.value)
+            return;
+
+        // several changes on the same frame, the last one is what got rendered
+        if (track.keys.back().frame == key.frame) {
+            track.keys.back() = key;
+            return;
+        }
+    }
+    track.keys.push_back(key);
+}
+
+template<typename T>
+static void write(FILE* _file, const T& _value) {
+    fwrite(&_value, sizeof(T), 1, _file);
+}
+
+template<typename T>
+static bool read(FILE* _file, T& _value) {
+    return fread(&_value, sizeof(T), 1, _file) == 1;
+}
+
+bool UniformAutomation::stop() {
+    if (!m_recording)
+        return false;
+    m_recording = false;
+
+    FILE* file = fopen(m_file.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Can't write the automation tracks to " << m_file << std::endl;
+        return false;
+    }
+
+    fwrite("GVAT", 1, 4, file);
+    write(file, (uint32_t)AUTOMATION_VERSION);
+    write(file, (uint32_t)m_tracks.size());
+    for (std::map<std::string, AutomationTrack>::const_iterator it = m_tracks.begin(); it != m_tracks.end(); ++it) {
+        const AutomationTrack& track = it->second;
+        write(file, (uint16_t)track.name.size());
+        fwrite(track.name.c_str(), 1, track.name.size(), file);
+        write(file, (uint8_t)track.size);
+        write(file, (uint8_t)track.bInt);
+        write(file, (uint32_t)track.keys.size());
+        for (size_t k = 0; k < track.keys.size(); k++) {
+            write(file, track.keys[k].time);
+            write(file, track.keys[k].frame);
+            fwrite(track.keys[k].value.data(), sizeof(float), track.size, file);
+        }
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    if (!ok)
+        std::cerr << "Failed writing the automation tracks to " << m_file << std::endl;
+    return ok;
+}
+
+bool UniformAutomation::load(const std::string& _file, AutomationInterpolation _interpolation) {
+    clear();
+
+    FILE* file = fopen(_file.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Can't open the automation tracks " << _file << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t tracks = 0;
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "GVAT", 4) == 0 &&
+                read(file, version) && version == AUTOMATION_VERSION &&
+                read(file, tracks);
+
+    for (uint32_t t = 0; ok && t < tracks; t++) {
+        AutomationTrack track;
+        uint16_t length = 0;
+        uint8_t size = 0, bInt = 0;
+        uint32_t keys = 0;
+        ok = read(file, length);
+        if (ok) {
+            track.name.resize(length);
+            ok = fread(&track.name[0], 1, length, file) == length;
+        }
+        ok = ok && read(file, size) && read(file, bInt) && read(file, keys) && size >= 1 && size <= 4;
+        track.size = size;
+        track.bInt = bInt != 0;
+
+        for (uint32_t k = 0; ok && k < keys; k++) {
+            AutomationKey key;
+            key.value.fill(0.0f);
+            ok = read(file, key.time) && read(file, key.frame) && 
+                 fread(key.value.data(), sizeof(float), size, file) == size;
+            track.keys.push_back(key);
+        }
+
+        if (ok && track.keys.size() > 0)
+            m_tracks[track.name] = track;
+    }
+    fclose(file);
+
+    if (!ok) {
+        std::cerr << _file << " is not a valid automation file" << std::endl;
+        m_tracks.clear();
+        return false;
+    }
+
+    m_file = _file;
+    m_interpolation = _interpolation;
+    m_playing = true;
+    return true;
+}
+
+void UniformAutomation::clear() {
+    m_tracks.clear();
+    m_file = "";
+    m_recording = false;
+    m_playing = false;
+}
+
+static float catmullRom(float _p0, float _p1, float _p2, float _p3, float _t) {
+    float t2 = _t * _t;
+    float t3 = t2 * _t;
+    return 0.5f * ( (2.0f * _p1) + (-_p0 + _p2) * _t +
+                    (2.0f * _p0 - 5.0f * _p1 + 4.0f * _p2 - _p3) * t2 +
+                    (-_p0 + 3.0f * _p1 - 3.0f * _p2 + _p3) * t3 );
+}
+
+void UniformAutomation::apply(float _time, AutomationCallback _callback) const {
+    if (!m_playing)
+        return;
+
+    for (std::map<std::string, AutomationTrack>::const_iterator it = m_tracks.begin(); it != m_tracks.end(); ++it) {
+        const std::vector<AutomationKey>& keys = it->second.keys;
+
+        // first key after _time
+        std::vector<AutomationKey>::const_iterator next = std::upper_bound(keys.begin(), keys.end(), _time, 
+            [](float _t, const AutomationKey& _key) { return _t < _key.time; });
+
+        std::array<float, 4> value;
+        if (next == keys.begin())
+            value = keys.front().value;
+        else if (next == keys.end() || m_interpolation == AUTOMATION_STEP)
+            value = (next - 1)->value;
+        else {
+            size_t i2 = next - keys.begin();
+            size_t i1 = i2 - 1;
+            size_t i0 = (i1 > 0)? i1 - 1 : i1;
+            size_t i3 = (i2 + 1 < keys.size())? i2 + 1 : i2;
+
+            float span = keys[i2].time - keys[i1].time;
+            float t = (span > 0.0f)? (_time - keys[i1].time) / span : 1.0f;
+            for (size_t c = 0; c < 4; c++) {
+                if (m_interpolation == AUTOMATION_SPLINE)
+                    value[c] = catmullRom(keys[i0].value[c], keys[i1].value[c], keys[i2].value[c], keys[i3].value[c], t);
+                else
+                    value[c] = keys[i1].value[c] + (keys[i2].value[c] - keys[i1].value[c]) * t;
+            }
+        }
+
+        _callback(it->first, value, it->second.size, it->second.bInt);
+    }
+}
+
+size_t UniformAutomation::getKeys() const {
+    size_t total = 0;
+    for (std::map<std::string, AutomationTrack>::const_iterator it = m_tracks.begin(); it != m_tracks.end(); ++it)
+        total += it->second.keys.size();
+    return total;
+}
+
+float UniformAutomation::getDuration() const {
+    float duration = 0.0f;
+    for (std::map<std::string, AutomationTrack>::const_iterator it = m_tracks.begin(); it != m_tracks.end(); ++it)
+        duration = std::max(duration, it->second.keys.back().time);
+    return duration;
+}
+
+std::string toString(AutomationInterpolation _interpolation) {
+    if (_interpolation == AUTOMATION_STEP)
+        return "step";
+    else if (_interpolation == AUTOMATION_SPLINE)
+        return "spline";
+    return "linear";
+}
+
+AutomationInterpolation toAutomationInterpolation(const std::string& _name) {
+    if (_name == "step")
+        return AUTOMATION_STEP;
+    else if (_name == "spline")
+        return AUTOMATION_SPLINE;
+    return AUTOMATION_LINEAR;
+}
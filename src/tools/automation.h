@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+enum AutomationInterpolation {
+    AUTOMATION_STEP = 0,    // hold each value until the next one
+    AUTOMATION_LINEAR,
+    AUTOMATION_SPLINE       // Catmull-Rom through the keys
+};
+
+struct AutomationKey {
+    float                   time;
+    uint32_t                frame;
+    std::array<float, 4>    value;
+};
+
+struct AutomationTrack {
+    std::string                 name;
+    size_t                      size    = 1;
+    bool                        bInt    = false;
+    std::vector<AutomationKey>  keys;
+};
+
+typedef std::function<void(const std::string&, const std::array<float, 4>&, size_t, bool)> AutomationCallback;
+
+/** Records the changes of the user uniforms of a live session (console, OSC) as keys on
+ *  u_time, and plays them back from the recording time while exporting, so the same
+ *  performance renders again frame by frame. Tracks are saved as a compact binary file:
+ *
+ *      "GVAT" | uint32 version | uint32 tracks
+ *      per track: uint16 name length | name | uint8 size | uint8 int | uint32 keys
+ *      per key:   float time | uint32 frame | float value[size] **/
+class UniformAutomation {
+public:
+    UniformAutomation();
+    virtual ~UniformAutomation();
+
+    // Recording
+    void    record(const std::string& _file);
+    bool    isRecording() const { return m_recording; }
+    void    capture(const std::string& _name, const float* _value, size_t _size, bool _int, float _time, size_t _frame);
+    bool    stop();
+
+    // Playback
+    bool    load(const std::string& _file, AutomationInterpolation _interpolation = AUTOMATION_LINEAR);
+    void    setInterpolation(AutomationInterpolation _interpolation) { m_interpolation = _interpolation; }
+    bool    isPlaying() const { return m_playing; }
+    void    apply(float _time, AutomationCallback _callback) const;
+    void    clear();
+
+    const std::string&  getFile() const { return m_file; }
+    size_t              getTracks() const { return m_tracks.size(); }
+    size_t              getKeys() const;
+    float               getDuration() const;
+    AutomationInterpolation getInterpolation() const { return m_interpolation; }
+
+private:
+    std::map<std::string, AutomationTrack>  m_tracks;
+    std::string                             m_file;
+    AutomationInterpolation                 m_interpolation;
+    bool                                    m_recording;
+    bool                                    m_playing;
+};
+
+std::string             toString(AutomationInterpolation _interpolation);
+AutomationInterpolation toAutomationInterpolation(const std::string& _name);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <atomic>
+
+using Pixels        = std::unique_ptr<unsigned char[]>;
+using SharedPixels  = std::shared_ptr<unsigned char>;     // a frame handed to several consumers
+
+/** Recycles the frame buffers used while recording so that, once the pool is warm,
+ *  the pixels of a captured frame don't allocate nor free memory. Only the pixels:
+ *  the shared_ptr that hands a frame to its sinks, the save jobs and the tasks queued
+ *  for them still make small allocations per frame. Buffers are kept by size, so
+ *  reads of different shapes (video planes, RGBA images, ...) can share a pool.
+ *  Buffers can be released from any thread **/
+class FramePool {
+public:
+    FramePool() : m_allocations(0) {}
+
+    // Make sure there are at least _count free buffers of _bytes
+    void allocate( size_t _bytes, size_t _count ) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<Pixels>& free = m_free[_bytes];
+        if (free.capacity() < _count * 2)
+            free.reserve( _count * 2 );
+        while (free.size() < _count) {
+            free.push_back( Pixels(new unsigned char[_bytes]) );
+            m_allocations++;
+        }
+    }
+
+    // Get a buffer of _bytes, only allocating when there is no free one of that size
+    Pixels acquire( size_t _bytes ) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<Pixels>& free = m_free[_bytes];
+            if (free.size() > 0) {
+                Pixels pixels = std::move(free.back());
+                free.pop_back();
+                return pixels;
+            }
+        }
+
+        m_allocations++;
+        return Pixels(new unsigned char[_bytes]);
+    }
+
+    // Give back a buffer of _bytes obtained with acquire(). Sizes dropped by clear() are freed
+    void release( Pixels&& _pixels, size_t _bytes ) {
+        if (!_pixels)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<size_t, std::vector<Pixels> >::iterator it = m_free.find(_bytes);
+        if (it != m_free.end())
+            it->second.push_back( std::move(_pixels) );
+        else
+            _pixels = nullptr;
+    }
+
+    // Free all the buffers, the ones still in use are freed as they come back
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.clear();
+    }
+
+    size_t getFree( size_t _bytes ) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<size_t, std::vector<Pixels> >::const_iterator it = m_free.find(_bytes);
+        return (it != m_free.end())? it->second.size() : 0;
+    }
+    size_t getAllocations() const { return m_allocations.load(); }
+
+private:
+    mutable std::mutex                          m_mutex;
+    std::map<size_t, std::vector<Pixels> >      m_free;
+    std::atomic<size_t>                         m_allocations;
+};
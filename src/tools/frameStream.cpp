@@ -0,0 +1,173 @@
+#include "frameStream.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+#if !defined(_WIN32)
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "yuv420.h"
+
+static int gcd(int _a, int _b) {
+    while (_b != 0) {
+        int t = _a % _b;
+        _a = _b;
+        _b = t;
+    }
+    return _a;
+}
+
+// fps as a fraction, 29.97 goes as 30000:1001 and 12.5 as 25:2
+static void fpsFraction(float _fps, int& _num, int& _den) {
+    _num = (int)std::round(_fps * 1000.0f);
+    _den = 1000;
+    if (std::fabs(_fps - std::round(_fps)) < 0.001f) {
+        _num = (int)std::round(_fps);
+        _den = 1;
+    }
+    else if (std::fabs(_fps * 1.001f - std::round(_fps * 1.001f)) < 0.01f) {
+        _num = (int)std::round(_fps * 1.001f) * 1000;
+        _den = 1001;
+    }
+    int d = gcd(_num, _den);
+    if (d > 1) {
+        _num /= d;
+        _den /= d;
+    }
+}
+
+static void putU32(unsigned char* _dst, uint32_t _value) {
+    for (int i = 0; i < 4; i++)
+        _dst[i] = (_value >> (i * 8)) & 0xFF;
+}
+
+std::string toString(FrameStreamFormat _format) {
+    return (_format == STREAM_RGBA)? "raw" : "y4m";
+}
+
+FrameStreamFormat toFrameStreamFormat(const std::string& _name) {
+    return (_name == "raw" || _name == "rgba")? STREAM_RGBA : STREAM_Y4M;
+}
+
+FrameStream::FrameStream() : m_file(nullptr), m_format(STREAM_Y4M), m_frames(0), m_width(0), m_height(0) {
+}
+
+FrameStream::~FrameStream() {
+    close();
+}
+
+bool FrameStream::open(const std::string& _path, FrameStreamFormat _format) {
+    close();
+
+    if (_path == "-") {
+        #if defined(_WIN32)
+        std::cerr << "Streaming to stdout is not supported on this platform" << std::endl;
+        return false;
+        #else
+        // keep the real stdout for the frames and send everything else printed to stderr
+        std::cout.flush();
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            std::cerr << "Can't take over stdout to stream frames" << std::endl;
+            return false;
+        }
+        m_file = fdopen(fd, "wb");
+        #endif
+    }
+    else
+        m_file = fopen(_path.c_str(), "wb");
+
+    if (!m_file) {
+        std::cerr << "Can't open " << _path << " to stream frames" << std::endl;
+        return false;
+    }
+
+    #if !defined(_WIN32)
+    // a reader that goes away makes writes fail instead of killing the process
+    signal(SIGPIPE, SIG_IGN);
+    #endif
+
+    m_path = _path;
+    m_format = _format;
+    m_frames = 0;
+    m_width = 0;
+    m_height = 0;
+    return true;
+}
+
+void FrameStream::close() {
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+size_t FrameStream::write(const unsigned char* _pixels, int _width, int _height, float _fps) {
+    if (!m_file)
+        return 0;
+
+    size_t bytes = 0;
+    if (m_frames == 0) {
+        if (m_format == STREAM_Y4M) {
+            if (_width % 2 != 0 || _height % 2 != 0) {
+                std::cerr << "Y4M streams need an even width and height, not " << _width << "x" << _height << std::endl;
+                close();
+                return 0;
+            }
+
+            int num, den;
+            fpsFraction(_fps, num, den);
+            int header = fprintf(m_file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", _width, _height, num, den);
+            bytes += (header > 0)? header : 0;
+        }
+        m_width = _width;
+        m_height = _height;
+    }
+    else if (m_format == STREAM_Y4M && (_width != m_width || _height != m_height)) {
+        std::cerr << "Frames can't change size in the middle of a stream (" << _width << "x" << _height << " instead of " << m_width << "x" << m_height << ")" << std::endl;
+        return 0;
+    }
+
+    bool ok = true;
+    if (m_format == STREAM_Y4M) {
+        size_t planes = getYUV420Bytes(_width, _height);
+        ok = fwrite("FRAME\n", 1, 6, m_file) == 6;
+        ok = ok && fwrite(_pixels, 1, planes, m_file) == planes;
+        bytes += 6 + planes;
+    }
+    else {
+        size_t stride = (size_t)_width * 4;
+
+        int num, den;
+        fpsFraction(_fps, num, den);
+        unsigned char header[FRAME_STREAM_HEADER_BYTES];
+        memcpy(header, "GVRF", 4);
+        putU32(header + 4, _width);
+        putU32(header + 8, _height);
+        putU32(header + 12, num);
+        putU32(header + 16, den);
+        putU32(header + 20, (uint32_t)(m_frames & 0xFFFFFFFF));
+        putU32(header + 24, (uint32_t)((uint64_t)m_frames >> 32));
+        putU32(header + 28, (uint32_t)(stride * _height));
+        ok = fwrite(header, 1, FRAME_STREAM_HEADER_BYTES, m_file) == FRAME_STREAM_HEADER_BYTES;
+        bytes += FRAME_STREAM_HEADER_BYTES;
+
+        for (int y = _height - 1; y >= 0 && ok; y--)
+            ok = fwrite(_pixels + stride * y, 1, stride, m_file) == stride;
+        bytes += stride * _height;
+    }
+
+    if (!ok) {
+        std::cerr << "Can't write more frames to " << m_path << ", the stream is closed" << std::endl;
+        close();
+        return 0;
+    }
+
+    m_frames++;
+    return bytes;
+}
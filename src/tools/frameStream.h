@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <cstdio>
+
+enum FrameStreamFormat {
+    STREAM_Y4M = 0,     // YUV4MPEG2, 4:2:0 planes packed on the GPU (see yuv420.h)
+    STREAM_RGBA         // raw RGBA frames, top row first, each one after a header
+};
+
+// Goes before every raw RGBA frame, so readers can tell its size and find the next one.
+// Besides the magic, all fields are little-endian uint32:
+//      0   magic, "GVRF"
+//      4   width
+//      8   height
+//      12  fps numerator
+//      16  fps denominator
+//      20  frame index in the stream (low, high)
+//      28  bytes of the pixels that follow, width * height * 4
+#define FRAME_STREAM_HEADER_BYTES 32
+
+/** Writes the recorded frames as an uncompressed video stream to a file, a fifo or stdout ("-"),
+ *  so glslViewer can feed any encoding pipeline. Writes block while the reader is busy, which
+ *  paces the recording to the speed of whatever consumes it **/
+class FrameStream {
+public:
+    FrameStream();
+    virtual ~FrameStream();
+
+    // Takes over stdout for "-": whatever else is printed goes to stderr from now on
+    bool    open(const std::string& _path, FrameStreamFormat _format);
+    void    close();
+    void    flush() { if (m_file) fflush(m_file); }
+
+    // _pixels are the packed I420 planes for Y4M or RGBA rows bottom-up, as they are read back.
+    // The Y4M header goes with the first frame, later frames have to keep its size. Raw RGBA
+    // frames carry their own header and can change size. Returns the bytes written, zero if it failed
+    size_t  write(const unsigned char* _pixels, int _width, int _height, float _fps);
+
+    bool    isOpen() const { return m_file != nullptr; }
+    FrameStreamFormat getFormat() const { return m_format; }
+    const std::string& getPath() const { return m_path; }
+    size_t  getFrames() const { return m_frames; }
+
+private:
+    std::string         m_path;
+    FILE*               m_file;
+    FrameStreamFormat   m_format;
+    size_t              m_frames;
+    int                 m_width;
+    int                 m_height;
+};
+
+std::string         toString(FrameStreamFormat _format);
+FrameStreamFormat   toFrameStreamFormat(const std::string& _name);
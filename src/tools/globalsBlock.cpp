@@ -0,0 +1,111 @@
+#include "globalsBlock.h"
+
+#include <fstream>
+#include <iostream>
+
+// Uniform buffers need GL 3.1+ / GLES 3.0+ (WebGL2)
+#if defined(GL_UNIFORM_BUFFER)
+#define UNIFORM_BLOCKS
+#endif
+
+static_assert(sizeof(GlobalsData) == 496, "GlobalsData doesn't match the std140 layout of the GLSL block");
+
+GlobalsBlock::GlobalsBlock() : m_ubo(0), m_enabled(false) {
+}
+
+GlobalsBlock::~GlobalsBlock() {
+    // GL objects are owned by the context, which is usually gone by now.
+}
+
+void GlobalsBlock::setEnabled(bool _enabled) {
+    #if defined(UNIFORM_BLOCKS)
+    m_enabled = _enabled;
+    #else
+    if (_enabled)
+        std::cerr << "Uniform buffers are not supported by this GL version" << std::endl;
+    m_enabled = false;
+    #endif
+}
+
+void GlobalsBlock::update() {
+    #if defined(UNIFORM_BLOCKS)
+    if (!m_enabled)
+        return;
+
+    if (m_ubo == 0) {
+        glGenBuffers(1, &m_ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(GlobalsData), &data, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, GLOBALS_BLOCK_BINDING, m_ubo);
+    }
+    else {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(GlobalsData), &data);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    #endif
+}
+
+void GlobalsBlock::bind(GLuint _program) {
+    #if defined(UNIFORM_BLOCKS)
+    if (!m_enabled || _program == 0)
+        return;
+
+    GLuint index = glGetUniformBlockIndex(_program, "GlslViewerGlobals");
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(_program, index, GLOBALS_BLOCK_BINDING);
+    #endif
+}
+
+void GlobalsBlock::clear() {
+    #if defined(UNIFORM_BLOCKS)
+    if (m_ubo != 0)
+        glDeleteBuffers(1, &m_ubo);
+    #endif
+    m_ubo = 0;
+}
+
+std::string GlobalsBlock::getSource() {
+    return  "#ifndef GLSLVIEWER_GLOBALS\n"
+            "#define GLSLVIEWER_GLOBALS\n"
+            "\n"
+            "layout(std140) uniform GlslViewerGlobals {\n"
+            "    vec4    u_date;\n"
+            "    vec2    u_resolution;\n"
+            "    vec2    u_mouse;\n"
+            "    float   u_time;\n"
+            "    float   u_delta;\n"
+            "    int     u_frame;\n"
+            "    float   u_cameraDistance;\n"
+            "    vec3    u_camera;\n"
+            "    float   u_cameraNearClip;\n"
+            "    float   u_cameraFarClip;\n"
+            "    float   u_cameraExposure;\n"
+            "    float   u_cameraEv100;\n"
+            "    float   u_iblLuminance;\n"
+            "    mat4    u_viewMatrix;\n"
+            "    mat4    u_inverseViewMatrix;\n"
+            "    mat4    u_projectionMatrix;\n"
+            "    mat4    u_inverseProjectionMatrix;\n"
+            "    mat3    u_normalMatrix;\n"
+            "    vec3    u_light;\n"
+            "    float   u_lightIntensity;\n"
+            "    vec3    u_lightColor;\n"
+            "    float   u_lightFalloff;\n"
+            "    vec3    u_lightDirection;\n"
+            "    float   u_globalsPadding;\n"
+            "    mat4    u_lightMatrix;\n"
+            "};\n"
+            "\n"
+            "#endif\n";
+}
+
+bool GlobalsBlock::save(const std::string& _file) {
+    std::ofstream out(_file.c_str());
+    if (!out.is_open()) {
+        std::cerr << "Can't write the globals block to " << _file << std::endl;
+        return false;
+    }
+    out << getSource();
+    return true;
+}
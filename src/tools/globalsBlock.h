@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+
+#include "vera/gl/gl.h"
+#include "glm/glm.hpp"
+
+// Binding point shared by every program that declares the block
+#define GLOBALS_BLOCK_BINDING 0
+
+/** std140 layout of the per-frame globals, member by member as declared by the GLSL
+ *  block GlobalsBlock::getSource() returns. vec3 are followed by a float to fill their
+ *  16 bytes and mat3 are stored as three vec4 columns **/
+struct GlobalsData {
+    glm::vec4   date;
+    glm::vec2   resolution;
+    glm::vec2   mouse;
+    float       time                = 0.0f;
+    float       delta               = 0.0f;
+    int         frame               = 0;
+    float       cameraDistance      = 0.0f;
+    glm::vec3   camera;
+    float       cameraNearClip      = 0.0f;
+    float       cameraFarClip       = 0.0f;
+    float       cameraExposure      = 0.0f;
+    float       cameraEv100         = 0.0f;
+    float       iblLuminance        = 0.0f;
+    glm::mat4   viewMatrix;
+    glm::mat4   inverseViewMatrix;
+    glm::mat4   projectionMatrix;
+    glm::mat4   inverseProjectionMatrix;
+    glm::vec4   normalMatrix[3];
+    glm::vec3   light;
+    float       lightIntensity      = 0.0f;
+    glm::vec3   lightColor;
+    float       lightFalloff        = 0.0f;
+    glm::vec3   lightDirection;
+    float       padding             = 0.0f;
+    glm::mat4   lightMatrix;
+};
+
+/** Opt-in uniform buffer with the globals every pass shares (time, resolution, mouse,
+ *  camera and the main light). It is uploaded once per frame and every program that
+ *  includes the block reads it through the same binding point, instead of getting each
+ *  value through its own glUniform calls **/
+class GlobalsBlock {
+public:
+    GlobalsBlock();
+    virtual ~GlobalsBlock();
+
+    void    setEnabled(bool _enabled);
+    bool    isEnabled() const { return m_enabled; }
+
+    // Uploads data (allocating the buffer the first time)
+    void    update();
+
+    // Points the program block to the shared binding, once per linked program
+    void    bind(GLuint _program);
+
+    // Release the GL buffer
+    void    clear();
+
+    // GLSL definition of the block, to #include in the shaders
+    static std::string getSource();
+    static bool        save(const std::string& _file);
+
+    GlobalsData         data;
+
+private:
+    GLuint              m_ubo;
+    bool                m_enabled;
+};
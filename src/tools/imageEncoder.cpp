@@ -0,0 +1,849 @@
+#include "imageEncoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+#include "vera/ops/fs.h"
+#include "vera/ops/pixel.h"
+#include "thread_pool/thread_pool.hpp"
+
+#if defined(SUPPORT_ZLIB)
+#include <zlib.h>
+#endif
+
+// encodes running at the same time, so strips don't oversubscribe the cores
+// when several frames are already being saved in parallel
+static std::atomic<int> s_active(0);
+
+// strips of all the frames being saved run on the same workers, one per core,
+// instead of threads of their own for each frame
+static thread_pool::ThreadPool& getStripThreads() {
+    static thread_pool::ThreadPool threads( std::max(1U, std::thread::hardware_concurrency()) );
+    return threads;
+}
+
+// how many parts of _rows are encoded in parallel, each of them at least _minRows long
+static int getStrips(const ImageEncoderSettings& _settings, int _width, int _rows, int _minRows) {
+    int strips = _settings.strips;
+    if (strips <= 0) {
+        // only big frames are worth splitting, sharing the cores with the other frames being saved
+        int cores = (int)std::thread::hardware_concurrency();
+        strips = 1;
+        if ((long long)_width * _rows >= 1920 * 1080 && cores > 1)
+            strips = cores / std::max(1, s_active.load());
+    }
+    return std::max(1, std::min(strips, _rows / _minRows));
+}
+
+std::string toString(PngFilter _filter) {
+    if (_filter == PNG_FILTER_NONE)         return "none";
+    else if (_filter == PNG_FILTER_SUB)     return "sub";
+    else if (_filter == PNG_FILTER_UP)      return "up";
+    return "adaptive";
+}
+
+PngFilter toPngFilter(const std::string& _name) {
+    if (_name == "none")        return PNG_FILTER_NONE;
+    else if (_name == "sub")    return PNG_FILTER_SUB;
+    else if (_name == "up")     return PNG_FILTER_UP;
+    return PNG_FILTER_ADAPTIVE;
+}
+
+bool savePixelsFast(const std::string& _path, const unsigned char* _pixels, int _width, int _height, const ImageEncoderSettings& _settings) {
+    std::string ext = vera::getExt(_path);
+
+    if (_settings.enabled) {
+        if (ext == "tga" || ext == "TGA")
+            return savePixelsTGA(_path, _pixels, _width, _height);
+
+        #if defined(SUPPORT_ZLIB)
+        if (ext == "png" || ext == "PNG")
+            return savePixelsPNG(_path, _pixels, _width, _height, _settings);
+        #endif
+    }
+
+    return vera::savePixels(_path, const_cast<unsigned char*>(_pixels), _width, _height);
+}
+
+bool savePixelsTGA(const std::string& _path, const unsigned char* _pixels, int _width, int _height) {
+    FILE* file = fopen(_path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Can't open " << _path << " for writing" << std::endl;
+        return false;
+    }
+
+    // uncompressed true-color, 32 bits with 8 bits of alpha, origin at the bottom-left like glReadPixels
+    unsigned char header[18];
+    memset(header, 0, 18);
+    header[2] = 2;
+    header[12] = _width & 0xFF;
+    header[13] = (_width >> 8) & 0xFF;
+    header[14] = _height & 0xFF;
+    header[15] = (_height >> 8) & 0xFF;
+    header[16] = 32;
+    header[17] = 8;
+    fwrite(header, 1, 18, file);
+
+    size_t stride = (size_t)_width * 4;
+    std::vector<unsigned char> row(stride);
+    for (int y = 0; y < _height; y++) {
+        const unsigned char* src = _pixels + y * stride;
+        for (size_t x = 0; x < stride; x += 4) {
+            row[x    ] = src[x + 2];
+            row[x + 1] = src[x + 1];
+            row[x + 2] = src[x    ];
+            row[x + 3] = src[x + 3];
+        }
+        fwrite(row.data(), 1, stride, file);
+    }
+
+    return fclose(file) == 0;
+}
+
+bool savePixelsNPY(const std::string& _path, const float* _pixels, int _width, int _height, int _channels) {
+    // version 1.0 header, padded so the data starts aligned to 64 bytes
+    std::string shape = "(" + std::to_string(_height) + ", " + std::to_string(_width) + ((_channels > 1)? ", " + std::to_string(_channels) : "") + ")";
+    std::string dict = "{'descr': '<f4', 'fortran_order': False, 'shape': " + shape + ", }";
+    size_t total = 10 + dict.size() + 1;
+    dict.append( (64 - total % 64) % 64, ' ' );
+    dict += '\n';
+
+    FILE* file = fopen(_path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Can't open " << _path << " for writing" << std::endl;
+        return false;
+    }
+
+    unsigned char preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, 0, 0 };
+    preamble[8] = dict.size() & 0xFF;
+    preamble[9] = (dict.size() >> 8) & 0xFF;
+    fwrite(preamble, 1, 10, file);
+    fwrite(dict.data(), 1, dict.size(), file);
+
+    // rows top-down, as numpy (and everybody else) expects
+    size_t stride = (size_t)_width * _channels;
+    for (int y = _height - 1; y >= 0; y--)
+        fwrite(_pixels + stride * y, sizeof(float), stride, file);
+
+    return fclose(file) == 0;
+}
+
+bool savePixelsData(const std::string& _path, const float* _pixels, int _width, int _height, int _channels, const ImageEncoderSettings& _settings) {
+    std::string ext = vera::getExt(_path);
+    if (ext == "npy" || ext == "NPY")
+        return savePixelsNPY(_path, _pixels, _width, _height, _channels);
+    return savePixelsEXR(_path, _pixels, _width, _height, _settings, _channels, true);
+}
+
+#if defined(SUPPORT_ZLIB)
+
+static void writeU32(std::vector<unsigned char>& _out, unsigned int _value) {
+    _out.push_back((_value >> 24) & 0xFF);
+    _out.push_back((_value >> 16) & 0xFF);
+    _out.push_back((_value >> 8) & 0xFF);
+    _out.push_back(_value & 0xFF);
+}
+
+static void writeChunk(FILE* _file, const char* _type, const unsigned char* _data, size_t _size) {
+    std::vector<unsigned char> head;
+    writeU32(head, (unsigned int)_size);
+    head.insert(head.end(), _type, _type + 4);
+
+    unsigned long crc = crc32(0L, (const Bytef*)_type, 4);
+    if (_size > 0)
+        crc = crc32(crc, _data, (uInt)_size);
+
+    std::vector<unsigned char> tail;
+    writeU32(tail, (unsigned int)crc);
+
+    fwrite(head.data(), 1, head.size(), _file);
+    if (_size > 0)
+        fwrite(_data, 1, _size, _file);
+    fwrite(tail.data(), 1, tail.size(), _file);
+}
+
+static inline unsigned char paeth(int _a, int _b, int _c) {
+    int p = _a + _b - _c;
+    int pa = abs(p - _a);
+    int pb = abs(p - _b);
+    int pc = abs(p - _c);
+    if (pa <= pb && pa <= pc)
+        return _a;
+    else if (pb <= pc)
+        return _b;
+    return _c;
+}
+
+// Filters one row (_prev is nullptr for the first one) into _out, which starts with the filter type byte
+static void filterRow(const unsigned char* _row, const unsigned char* _prev, size_t _stride, PngFilter _filter, unsigned char* _out) {
+    const size_t bpp = 4;
+
+    if (_filter == PNG_FILTER_ADAPTIVE) {
+        // pick the filter with the smallest sum of absolute (signed) differences
+        unsigned long best = ~0UL;
+        unsigned char type = 0;
+        for (unsigned char t = 0; t < 5; t++) {
+            unsigned long sum = 0;
+            for (size_t x = 0; x < _stride; x++) {
+                int a = (x >= bpp)? _row[x - bpp] : 0;
+                int b = _prev? _prev[x] : 0;
+                int c = (_prev && x >= bpp)? _prev[x - bpp] : 0;
+                unsigned char v = _row[x];
+                if (t == 1)         v -= a;
+                else if (t == 2)    v -= b;
+                else if (t == 3)    v -= (a + b) / 2;
+                else if (t == 4)    v -= paeth(a, b, c);
+                sum += (v < 128)? v : 256 - v;
+                if (sum >= best)
+                    break;
+            }
+            if (sum < best) {
+                best = sum;
+                type = t;
+            }
+        }
+
+        _out[0] = type;
+        for (size_t x = 0; x < _stride; x++) {
+            int a = (x >= bpp)? _row[x - bpp] : 0;
+            int b = _prev? _prev[x] : 0;
+            int c = (_prev && x >= bpp)? _prev[x - bpp] : 0;
+            unsigned char v = _row[x];
+            if (type == 1)      v -= a;
+            else if (type == 2) v -= b;
+            else if (type == 3) v -= (a + b) / 2;
+            else if (type == 4) v -= paeth(a, b, c);
+            _out[x + 1] = v;
+        }
+        return;
+    }
+
+    _out[0] = (unsigned char)_filter;
+    if (_filter == PNG_FILTER_SUB) {
+        memcpy(_out + 1, _row, bpp);
+        for (size_t x = bpp; x < _stride; x++)
+            _out[x + 1] = _row[x] - _row[x - bpp];
+    }
+    else if (_filter == PNG_FILTER_UP && _prev) {
+        for (size_t x = 0; x < _stride; x++)
+            _out[x + 1] = _row[x] - _prev[x];
+    }
+    else
+        memcpy(_out + 1, _row, _stride);
+}
+
+struct PngStrip {
+    int                         begin   = 0;
+    int                         end     = 0;
+    std::vector<unsigned char>  data;
+    unsigned long               adler   = 1;
+    size_t                      length  = 0;
+    bool                        ok      = false;
+};
+
+// Filters and deflates the PNG rows [begin, end) of the strip as a raw deflate stream. Strips are
+// byte aligned (Z_SYNC_FLUSH) so they can be concatenated, only the last one closes the stream
+static void deflateStrip(PngStrip* _strip, const unsigned char* _pixels, int _width, int _height, const ImageEncoderSettings& _settings, bool _last) {
+    size_t stride = (size_t)_width * 4;
+    std::vector<unsigned char> filtered( (stride + 1) * (_strip->end - _strip->begin) );
+
+    for (int y = _strip->begin; y < _strip->end; y++) {
+        // PNG rows go top-down
+        const unsigned char* row = _pixels + (size_t)(_height - 1 - y) * stride;
+        const unsigned char* prev = (y > 0)? row + stride : nullptr;
+        filterRow(row, prev, stride, _settings.filter, &filtered[(y - _strip->begin) * (stride + 1)]);
+    }
+
+    _strip->length = filtered.size();
+    _strip->adler = adler32(1L, filtered.data(), (uInt)filtered.size());
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    int level = (_settings.level < 0)? 0 : ((_settings.level > 9)? 9 : _settings.level);
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+
+    _strip->data.resize( deflateBound(&stream, (uLong)filtered.size()) + 16 );
+    stream.next_in = filtered.data();
+    stream.avail_in = (uInt)filtered.size();
+    stream.next_out = _strip->data.data();
+    stream.avail_out = (uInt)_strip->data.size();
+
+    int ret = deflate(&stream, _last? Z_FINISH : Z_SYNC_FLUSH);
+    _strip->ok = _last? (ret == Z_STREAM_END) : (ret == Z_OK && stream.avail_in == 0);
+    _strip->data.resize(stream.total_out);
+    deflateEnd(&stream);
+}
+
+bool savePixelsPNG(const std::string& _path, const unsigned char* _pixels, int _width, int _height, const ImageEncoderSettings& _settings) {
+    s_active++;
+
+    int strips = getStrips(_settings, _width, _height, 16);
+
+    std::vector<PngStrip> parts(strips);
+    int rows = _height / strips;
+    for (int i = 0; i < strips; i++) {
+        parts[i].begin = i * rows;
+        parts[i].end = (i == strips - 1)? _height : (i + 1) * rows;
+    }
+
+    if (strips == 1)
+        deflateStrip(&parts[0], _pixels, _width, _height, _settings, true);
+    else {
+        std::vector< std::future<void> > done;
+        for (int i = 1; i < strips; i++) {
+            PngStrip* strip = &parts[i];
+            bool last = i == strips - 1;
+            done.push_back( getStripThreads().Submit([strip, _pixels, _width, _height, &_settings, last]() {
+                deflateStrip(strip, _pixels, _width, _height, _settings, last);
+            }) );
+        }
+        deflateStrip(&parts[0], _pixels, _width, _height, _settings, false);
+        for (size_t i = 0; i < done.size(); i++)
+            done[i].wait();
+    }
+
+    s_active--;
+
+    for (int i = 0; i < strips; i++)
+        if (!parts[i].ok) {
+            std::cerr << "Can't compress " << _path << std::endl;
+            return false;
+        }
+
+    FILE* file = fopen(_path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Can't open " << _path << " for writing" << std::endl;
+        return false;
+    }
+
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    fwrite(signature, 1, 8, file);
+
+    std::vector<unsigned char> ihdr;
+    writeU32(ihdr, _width);
+    writeU32(ihdr, _height);
+    ihdr.push_back(8);      // bit depth
+    ihdr.push_back(6);      // RGBA
+    ihdr.push_back(0);      // deflate
+    ihdr.push_back(0);      // adaptive filtering
+    ihdr.push_back(0);      // no interlace
+    writeChunk(file, "IHDR", ihdr.data(), ihdr.size());
+
+    // zlib header, the level bits are informative only
+    unsigned char zheader[2] = { 0x78, 0x01 };
+    if (_settings.level >= 7)       zheader[1] = 0xDA;
+    else if (_settings.level >= 6)  zheader[1] = 0x9C;
+    else if (_settings.level >= 2)  zheader[1] = 0x5E;
+    writeChunk(file, "IDAT", zheader, 2);
+
+    // each strip goes in its own IDAT, the checksum of the whole stream is stitched from the strips
+    unsigned long adler = parts[0].adler;
+    for (int i = 0; i < strips; i++) {
+        if (i > 0)
+            adler = adler32_combine(adler, parts[i].adler, (z_off_t)parts[i].length);
+        writeChunk(file, "IDAT", parts[i].data.data(), parts[i].data.size());
+    }
+
+    std::vector<unsigned char> zfooter;
+    writeU32(zfooter, (unsigned int)adler);
+    writeChunk(file, "IDAT", zfooter.data(), zfooter.size());
+    writeChunk(file, "IEND", nullptr, 0);
+
+    return fclose(file) == 0;
+}
+
+#else
+
+bool savePixelsPNG(const std::string& _path, const unsigned char* _pixels, int _width, int _height, const ImageEncoderSettings&) {
+    return vera::savePixels(_path, const_cast<unsigned char*>(_pixels), _width, _height);
+}
+
+#endif
+
+// ---------------------------------------------------------------------- STREAM
+
+ImageStreamWriter::ImageStreamWriter() : m_file(nullptr), m_zstream(nullptr), m_width(0), m_height(0), m_row(0), m_png(false) {
+}
+
+ImageStreamWriter::~ImageStreamWriter() {
+    close();
+}
+
+bool ImageStreamWriter::open(const std::string& _path, int _width, int _height, const ImageEncoderSettings& _settings) {
+    close();
+
+    std::string ext = vera::getExt(_path);
+    m_png = (ext == "png" || ext == "PNG");
+    if (!m_png && ext != "tga" && ext != "TGA") {
+        std::cerr << "Only png and tga images can be written by bands, not " << _path << std::endl;
+        return false;
+    }
+
+    #if !defined(SUPPORT_ZLIB)
+    if (m_png) {
+        std::cerr << "Writing " << _path << " by bands needs zlib, use tga instead" << std::endl;
+        return false;
+    }
+    #endif
+
+    // TGA headers store the size in 16 bits
+    if (!m_png && (_width > 65535 || _height > 65535)) {
+        std::cerr << "TGA images can't be bigger than 65535x65535, use png for " << _path << std::endl;
+        return false;
+    }
+
+    m_file = fopen(_path.c_str(), "wb");
+    if (!m_file) {
+        std::cerr << "Can't open " << _path << " for writing" << std::endl;
+        return false;
+    }
+
+    m_settings = _settings;
+    m_width = _width;
+    m_height = _height;
+    m_row = 0;
+
+    if (!m_png) {
+        // same as savePixelsTGA but with the origin at the top-left, so the rows can go in the order they come
+        unsigned char header[18];
+        memset(header, 0, 18);
+        header[2] = 2;
+        header[12] = _width & 0xFF;
+        header[13] = (_width >> 8) & 0xFF;
+        header[14] = _height & 0xFF;
+        header[15] = (_height >> 8) & 0xFF;
+        header[16] = 32;
+        header[17] = 8 | 0x20;
+        fwrite(header, 1, 18, m_file);
+        m_line.resize((size_t)_width * 4);
+        return true;
+    }
+
+    #if defined(SUPPORT_ZLIB)
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    fwrite(signature, 1, 8, m_file);
+
+    std::vector<unsigned char> ihdr;
+    writeU32(ihdr, _width);
+    writeU32(ihdr, _height);
+    ihdr.push_back(8);      // bit depth
+    ihdr.push_back(6);      // RGBA
+    ihdr.push_back(0);      // deflate
+    ihdr.push_back(0);      // adaptive filtering
+    ihdr.push_back(0);      // no interlace
+    writeChunk(m_file, "IHDR", ihdr.data(), ihdr.size());
+
+    m_zstream = new z_stream;
+    memset(m_zstream, 0, sizeof(z_stream));
+    int level = (_settings.level < 0)? 0 : ((_settings.level > 9)? 9 : _settings.level);
+    if (deflateInit(m_zstream, level) != Z_OK) {
+        std::cerr << "Can't compress " << _path << std::endl;
+        delete m_zstream;
+        m_zstream = nullptr;
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+
+    m_prev.clear();
+    m_line.resize((size_t)_width * 4 + 1);
+    m_out.resize(256 * 1024);
+    #endif
+
+    return true;
+}
+
+bool ImageStreamWriter::write(const unsigned char* _band, int _rows) {
+    if (!m_file)
+        return false;
+
+    size_t stride = (size_t)m_width * 4;
+    _rows = std::min(_rows, m_height - m_row);
+
+    for (int i = _rows - 1; i >= 0; i--) {
+        const unsigned char* src = _band + (size_t)i * stride;
+
+        if (!m_png) {
+            for (size_t x = 0; x < stride; x += 4) {
+                m_line[x    ] = src[x + 2];
+                m_line[x + 1] = src[x + 1];
+                m_line[x + 2] = src[x    ];
+                m_line[x + 3] = src[x + 3];
+            }
+            fwrite(m_line.data(), 1, stride, m_file);
+        }
+        #if defined(SUPPORT_ZLIB)
+        else {
+            filterRow(src, m_prev.empty()? nullptr : m_prev.data(), stride, m_settings.filter, m_line.data());
+            m_prev.assign(src, src + stride);
+
+            m_zstream->next_in = m_line.data();
+            m_zstream->avail_in = (uInt)m_line.size();
+            if (!_deflate(Z_NO_FLUSH))
+                return false;
+        }
+        #endif
+    }
+
+    m_row += _rows;
+    return true;
+}
+
+bool ImageStreamWriter::_deflate(int _flush) {
+    #if defined(SUPPORT_ZLIB)
+    // IDAT chunks are written every time the output buffer fills up
+    int ret = Z_OK;
+    do {
+        m_zstream->next_out = m_out.data();
+        m_zstream->avail_out = (uInt)m_out.size();
+        ret = deflate(m_zstream, _flush);
+        if (ret == Z_STREAM_ERROR)
+            return false;
+
+        size_t size = m_out.size() - m_zstream->avail_out;
+        if (size > 0)
+            writeChunk(m_file, "IDAT", m_out.data(), size);
+    } while (m_zstream->avail_out == 0 || (_flush == Z_FINISH && ret != Z_STREAM_END));
+    return true;
+    #else
+    (void)_flush;
+    return false;
+    #endif
+}
+
+bool ImageStreamWriter::close() {
+    if (!m_file)
+        return false;
+
+    bool ok = (m_row == m_height);
+    if (!ok)
+        std::cerr << "Only " << m_row << " of " << m_height << " rows were written" << std::endl;
+
+    #if defined(SUPPORT_ZLIB)
+    if (m_zstream) {
+        m_zstream->next_in = nullptr;
+        m_zstream->avail_in = 0;
+        ok = _deflate(Z_FINISH) && ok;
+        deflateEnd(m_zstream);
+        delete m_zstream;
+        m_zstream = nullptr;
+
+        writeChunk(m_file, "IEND", nullptr, 0);
+    }
+    #endif
+
+    ok = (fclose(m_file) == 0) && ok;
+    m_file = nullptr;
+
+    m_prev.clear();
+    m_line.clear();
+    m_out.clear();
+    return ok;
+}
+
+// ---------------------------------------------------------------------- EXR
+
+std::string toString(ExrCompression _compression) {
+    if (_compression == EXR_NONE)           return "none";
+    else if (_compression == EXR_ZIPS)      return "zips";
+    return "zip";
+}
+
+ExrCompression toExrCompression(const std::string& _name) {
+    if (_name == "none")        return EXR_NONE;
+    else if (_name == "zips")   return EXR_ZIPS;
+    return EXR_ZIP;
+}
+
+bool savePixelsFloat(const std::string& _path, const float* _pixels, int _width, int _height, const ImageEncoderSettings& _settings) {
+    std::string ext = vera::getExt(_path);
+    if (ext == "exr" || ext == "EXR")
+        return savePixelsEXR(_path, _pixels, _width, _height, _settings);
+    return vera::savePixelsHDR(_path, const_cast<float*>(_pixels), _width, _height);
+}
+
+bool isFloatFormat(const std::string& _path) {
+    std::string ext = (_path.find('.') == std::string::npos)? _path : vera::getExt(_path);
+    return ext == "hdr" || ext == "HDR" || ext == "exr" || ext == "EXR";
+}
+
+// IEEE 754 half, rounding to nearest even
+static inline uint16_t floatToHalf(float _value) {
+    uint32_t x;
+    memcpy(&x, &_value, 4);
+    uint16_t sign = (x >> 16) & 0x8000;
+    uint32_t absx = x & 0x7FFFFFFF;
+
+    // Inf and NaN
+    if (absx >= 0x7F800000)
+        return sign | 0x7C00 | ((absx > 0x7F800000)? 0x0200 : 0);
+
+    // too big, rounds to Inf
+    if (absx >= 0x477FF000)
+        return sign | 0x7C00;
+
+    // normals
+    if (absx >= 0x38800000) {
+        uint32_t h = (absx - 0x38000000) >> 13;
+        uint32_t rest = absx & 0x1FFF;
+        if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+            h++;
+        return sign | (uint16_t)h;
+    }
+
+    // too small, rounds to zero
+    if (absx < 0x33000000)
+        return sign;
+
+    // subnormals
+    uint32_t mantissa = (absx & 0x007FFFFF) | 0x00800000;
+    int shift = 126 - (int)(absx >> 23);
+    uint32_t h = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t half = 1u << (shift - 1);
+    if (rest > half || (rest == half && (h & 1)))
+        h++;
+    return sign | (uint16_t)h;
+}
+
+static void floatsToHalvesScalar(const float* _in, uint16_t* _out, size_t _count) {
+    for (size_t i = 0; i < _count; i++)
+        _out[i] = floatToHalf(_in[i]);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+__attribute__((target("avx,f16c")))
+static void floatsToHalvesF16C(const float* _in, uint16_t* _out, size_t _count) {
+    size_t i = 0;
+    for (; i + 8 <= _count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(_in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(_out + i), h);
+    }
+    floatsToHalvesScalar(_in + i, _out + i, _count - i);
+}
+
+static void floatsToHalves(const float* _in, uint16_t* _out, size_t _count) {
+    static const bool f16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    if (f16c)
+        floatsToHalvesF16C(_in, _out, _count);
+    else
+        floatsToHalvesScalar(_in, _out, _count);
+}
+
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+
+static void floatsToHalves(const float* _in, uint16_t* _out, size_t _count) {
+    size_t i = 0;
+    for (; i + 4 <= _count; i += 4)
+        vst1_u16(_out + i, vreinterpret_u16_f16( vcvt_f16_f32( vld1q_f32(_in + i) ) ));
+    floatsToHalvesScalar(_in + i, _out + i, _count - i);
+}
+
+#else
+
+static void floatsToHalves(const float* _in, uint16_t* _out, size_t _count) {
+    floatsToHalvesScalar(_in, _out, _count);
+}
+
+#endif
+
+static void writeLE32(std::vector<unsigned char>& _out, uint32_t _value) {
+    for (int i = 0; i < 4; i++)
+        _out.push_back((_value >> (i * 8)) & 0xFF);
+}
+
+static void writeLE64(std::vector<unsigned char>& _out, uint64_t _value) {
+    for (int i = 0; i < 8; i++)
+        _out.push_back((_value >> (i * 8)) & 0xFF);
+}
+
+static void writeAttribute(std::vector<unsigned char>& _out, const char* _name, const char* _type, const std::vector<unsigned char>& _value) {
+    _out.insert(_out.end(), _name, _name + strlen(_name) + 1);
+    _out.insert(_out.end(), _type, _type + strlen(_type) + 1);
+    writeLE32(_out, (uint32_t)_value.size());
+    _out.insert(_out.end(), _value.begin(), _value.end());
+}
+
+struct ExrChunks {
+    int                                     begin = 0;  // first chunk
+    int                                     end   = 0;
+    std::vector< std::vector<unsigned char> > data;
+};
+
+// Packs (and compresses) the chunks [begin, end). Each one holds _lines scanlines, top-down,
+// with the channels in alphabetical order (A, B, G, R) as halves, or as floats when _float
+static void packChunks(ExrChunks* _chunks, const float* _pixels, int _width, int _height, int _channels, bool _float, int _lines, ExrCompression _compression) {
+    std::vector<uint16_t> row(_width * _channels);
+    std::vector<unsigned char> raw;
+    size_t bytes = _float? 4 : 2;
+
+    for (int c = _chunks->begin; c < _chunks->end; c++) {
+        int y0 = c * _lines;
+        int y1 = std::min(_height, y0 + _lines);
+
+        raw.resize((size_t)(y1 - y0) * _width * _channels * bytes);
+        uint16_t* dst = (uint16_t*)raw.data();
+        float* dstFloat = (float*)raw.data();
+        for (int y = y0; y < y1; y++) {
+            const float* src = _pixels + (size_t)(_height - 1 - y) * _width * _channels;
+            if (_float) {
+                for (int ch = _channels - 1; ch >= 0; ch--)
+                    for (int x = 0; x < _width; x++)
+                        *(dstFloat++) = src[x * _channels + ch];
+                continue;
+            }
+
+            floatsToHalves(src, row.data(), row.size());
+            for (int ch = _channels - 1; ch >= 0; ch--)
+                for (int x = 0; x < _width; x++)
+                    *(dst++) = row[x * _channels + ch];
+        }
+
+        std::vector<unsigned char> out;
+        writeLE32(out, y0);
+
+        #if defined(SUPPORT_ZLIB)
+        if (_compression != EXR_NONE) {
+            // split even and odd bytes and store the deltas, then deflate
+            std::vector<unsigned char> tmp(raw.size());
+            size_t half = (raw.size() + 1) / 2;
+            for (size_t i = 0; i < raw.size(); i++)
+                tmp[(i & 1)? half + i / 2 : i / 2] = raw[i];
+            int p = tmp[0];
+            for (size_t i = 1; i < tmp.size(); i++) {
+                int d = int(tmp[i]) - p + (128 + 256);
+                p = tmp[i];
+                tmp[i] = (unsigned char)d;
+            }
+
+            uLongf size = compressBound(tmp.size());
+            std::vector<unsigned char> zipped(size);
+            if (compress2(zipped.data(), &size, tmp.data(), tmp.size(), Z_DEFAULT_COMPRESSION) == Z_OK && size < raw.size()) {
+                writeLE32(out, (uint32_t)size);
+                out.insert(out.end(), zipped.begin(), zipped.begin() + size);
+                _chunks->data.push_back(out);
+                continue;
+            }
+        }
+        #else
+        (void)_compression;
+        #endif
+
+        // chunks that don't get smaller are stored as they are
+        writeLE32(out, (uint32_t)raw.size());
+        out.insert(out.end(), raw.begin(), raw.end());
+        _chunks->data.push_back(out);
+    }
+}
+
+bool savePixelsEXR(const std::string& _path, const float* _pixels, int _width, int _height, const ImageEncoderSettings& _settings, int _channels, bool _float) {
+    ExrCompression compression = _settings.exr;
+    #if !defined(SUPPORT_ZLIB)
+    compression = EXR_NONE;
+    #endif
+
+    int lines = (compression == EXR_ZIP)? 16 : 1;
+    int total = (_height + lines - 1) / lines;
+
+    s_active++;
+
+    int strips = getStrips(_settings, _width, total, 1);
+    std::vector<ExrChunks> parts(strips);
+    int count = total / strips;
+    for (int i = 0; i < strips; i++) {
+        parts[i].begin = i * count;
+        parts[i].end = (i == strips - 1)? total : (i + 1) * count;
+    }
+
+    if (strips == 1)
+        packChunks(&parts[0], _pixels, _width, _height, _channels, _float, lines, compression);
+    else {
+        std::vector< std::future<void> > done;
+        for (int i = 1; i < strips; i++) {
+            ExrChunks* chunks = &parts[i];
+            done.push_back( getStripThreads().Submit([chunks, _pixels, _width, _height, _channels, _float, lines, compression]() {
+                packChunks(chunks, _pixels, _width, _height, _channels, _float, lines, compression);
+            }) );
+        }
+        packChunks(&parts[0], _pixels, _width, _height, _channels, _float, lines, compression);
+        for (size_t i = 0; i < done.size(); i++)
+            done[i].wait();
+    }
+
+    s_active--;
+
+    std::vector<unsigned char> header = { 0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0 };
+
+    std::vector<unsigned char> value;
+    // a single channel is depth, Z by the EXR conventions
+    const char* channels[4] = { "A", "B", "G", "R" };
+    for (int i = 0; i < _channels; i++) {
+        value.push_back( (_channels == 1)? 'Z' : channels[4 - _channels + i][0] );
+        value.push_back(0);
+        writeLE32(value, _float? 2 : 1);    // FLOAT or HALF
+        writeLE32(value, 0);            // pLinear + reserved
+        writeLE32(value, 1);            // x sampling
+        writeLE32(value, 1);            // y sampling
+    }
+    value.push_back(0);
+    writeAttribute(header, "channels", "chlist", value);
+
+    value.clear();
+    value.push_back( (compression == EXR_ZIP)? 3 : ((compression == EXR_ZIPS)? 2 : 0) );
+    writeAttribute(header, "compression", "compression", value);
+
+    value.clear();
+    writeLE32(value, 0);
+    writeLE32(value, 0);
+    writeLE32(value, _width - 1);
+    writeLE32(value, _height - 1);
+    writeAttribute(header, "dataWindow", "box2i", value);
+    writeAttribute(header, "displayWindow", "box2i", value);
+
+    value.clear();
+    value.push_back(0);                 // INCREASING_Y
+    writeAttribute(header, "lineOrder", "lineOrder", value);
+
+    float one = 1.0f;
+    value.resize(4);
+    memcpy(value.data(), &one, 4);
+    writeAttribute(header, "pixelAspectRatio", "float", value);
+    writeAttribute(header, "screenWindowWidth", "float", value);
+
+    value.assign(8, 0);
+    writeAttribute(header, "screenWindowCenter", "v2f", value);
+
+    header.push_back(0);
+
+    // offsets table
+    uint64_t offset = header.size() + (uint64_t)total * 8;
+    for (int i = 0; i < strips; i++)
+        for (size_t j = 0; j < parts[i].data.size(); j++) {
+            writeLE64(header, offset);
+            offset += parts[i].data[j].size();
+        }
+
+    FILE* file = fopen(_path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Can't open " << _path << " for writing" << std::endl;
+        return false;
+    }
+
+    fwrite(header.data(), 1, header.size(), file);
+    for (int i = 0; i < strips; i++)
+        for (size_t j = 0; j < parts[i].data.size(); j++)
+            fwrite(parts[i].data[j].data(), 1, parts[i].data[j].size(), file);
+
+    return fclose(file) == 0;
+}
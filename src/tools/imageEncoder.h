@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+enum PngFilter {
+    PNG_FILTER_NONE = 0,
+    PNG_FILTER_SUB,
+    PNG_FILTER_UP,
+    PNG_FILTER_ADAPTIVE     // per row, the one with the smallest sum of absolute differences
+};
+
+enum ExrCompression {
+    EXR_NONE = 0,
+    EXR_ZIPS,               // deflate, one scanline per chunk
+    EXR_ZIP                 // deflate, 16 scanlines per chunk
+};
+
+/** How image sequences are encoded. When disabled frames go through vera::savePixels **/
+struct ImageEncoderSettings {
+    bool            enabled = true;
+    int             level   = 1;                // zlib compression level (0-9)
+    PngFilter       filter  = PNG_FILTER_UP;
+    int             strips  = 0;                // row strips encoded in parallel (0 = auto)
+    ExrCompression  exr     = EXR_ZIP;
+};
+
+// _pixels are RGBA rows as they come from glReadPixels (bottom-up)
+bool savePixelsFast(const std::string& _path, const unsigned char* _pixels, int _width, int _height, const ImageEncoderSettings& _settings);
+bool savePixelsPNG(const std::string& _path, const unsigned char* _pixels, int _width, int _height, const ImageEncoderSettings& _settings);
+bool savePixelsTGA(const std::string& _path, const unsigned char* _pixels, int _width, int _height);
+
+// _pixels are float RGBA rows as they come from glReadPixels (bottom-up), saved as half float EXR or RGBE HDR
+bool savePixelsFloat(const std::string& _path, const float* _pixels, int _width, int _height, const ImageEncoderSettings& _settings);
+bool savePixelsEXR(const std::string& _path, const float* _pixels, int _width, int _height, const ImageEncoderSettings& _settings, int _channels = 4, bool _float = false);
+
+// Float data of 1 (depth) or 4 channels, bottom-up, saved at full precision as EXR or NumPy .npy
+bool savePixelsData(const std::string& _path, const float* _pixels, int _width, int _height, int _channels, const ImageEncoderSettings& _settings);
+bool savePixelsNPY(const std::string& _path, const float* _pixels, int _width, int _height, int _channels);
+
+// True for the formats saved from float pixels (hdr, exr). Takes a path or just the extension
+bool isFloatFormat(const std::string& _path);
+
+/** Writes an image a band of rows at a time, so images too big to fit in memory can be saved
+ *  while they are rendered. Bands are RGBA rows, bottom-up like glReadPixels, and have to be
+ *  written from the top of the image down. Supports PNG (with zlib) and TGA **/
+struct z_stream_s;
+class ImageStreamWriter {
+public:
+    ImageStreamWriter();
+    virtual ~ImageStreamWriter();
+
+    bool    open(const std::string& _path, int _width, int _height, const ImageEncoderSettings& _settings);
+    bool    write(const unsigned char* _band, int _rows);
+    bool    close();
+
+    bool    isOpen() const { return m_file != nullptr; }
+    int     getRow() const { return m_row; }
+
+private:
+    bool    _deflate(int _flush);
+
+    FILE*                       m_file;
+    struct z_stream_s*          m_zstream;
+    ImageEncoderSettings        m_settings;
+    std::vector<unsigned char>  m_prev;
+    std::vector<unsigned char>  m_line;
+    std::vector<unsigned char>  m_out;
+    int                         m_width;
+    int                         m_height;
+    int                         m_row;
+    bool                        m_png;
+};
+
+std::string toString(PngFilter _filter);
+PngFilter   toPngFilter(const std::string& _name);
+
+std::string     toString(ExrCompression _compression);
+ExrCompression  toExrCompression(const std::string& _name);
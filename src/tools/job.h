@@ -1,49 +1,64 @@
 #pragma once
 
 #include <memory>
-#include <atomic>
 #include <string>
 #include <utility>
 
-#include "vera/ops/pixel.h"
+#include "framePool.h"
+#include "imageEncoder.h"
+#include "journal.h"
+#include "progress.h"
 
-/** Just a small helper that captures all the relevant data to save an image **/
+/** Just a small helper that captures all the relevant data to save an image. Float
+ *  data with _dataChannels (render passes like depth or normals) is saved as it is **/
 class Job {
 public:
     Job (const Job& ) = delete;
     Job (Job && ) = default;
-    Job (std::string _filename, int _width, int _height, std::unique_ptr<unsigned char[]>&& _pixels,
-         std::atomic<int>& _task_count, std::atomic<long long>& _max_mem_in_queue):
+    Job (std::string _filename, int _width, int _height, SharedPixels _pixels,
+         const ImageEncoderSettings& _encoder = ImageEncoderSettings(), RecordingJournal* _journal = nullptr, int _dataChannels = 0):
 
         m_filename(std::move(_filename)),
         m_width(_width),
         m_height(_height),
         m_pixels(std::move(_pixels)),
-        m_task_count(&_task_count),
-        m_max_mem_in_queue(&_max_mem_in_queue) {
-        if (m_pixels) {
-            _task_count++;
-            _max_mem_in_queue -= mem_consumed_by_pixels();
-        }
+        m_encoder(_encoder),
+        m_journal(_journal),
+        m_dataChannels(_dataChannels) {
     }
 
     /** the function that is being invoked when the task is done **/
     void operator()() {
         if (m_pixels) {
-            vera::savePixels(m_filename, m_pixels.get(), m_width, m_height);
+            bool saved = false;
+            if (m_dataChannels > 0)
+                saved = savePixelsData(m_filename, reinterpret_cast<const float*>(m_pixels.get()), m_width, m_height, m_dataChannels, m_encoder);
+            else if (isFloatFormat(m_filename))
+                saved = savePixelsFloat(m_filename, reinterpret_cast<const float*>(m_pixels.get()), m_width, m_height, m_encoder);
+            else
+                saved = savePixelsFast(m_filename, m_pixels.get(), m_width, m_height, m_encoder);
+
+            // only once it's on disk the frame can be skipped when resuming
+            if (saved && m_journal)
+                m_journal->add(m_filename);
+
+            // one less sink for this frame of the recording, if it's part of one
+            if (saved)
+                progressFileDone(m_filename);
+            else
+                progressOutputDone(0);
+
+            // other sinks may still be using the frame, the last one gives it back
             m_pixels = nullptr;
-            (*m_task_count)--;
-            (*m_max_mem_in_queue) += mem_consumed_by_pixels();
         }
     }
 protected:
-    long mem_consumed_by_pixels() const { return m_width * m_height * 4; }
-
     std::string                         m_filename;
     int                                 m_width;
     int                                 m_height;
-    std::unique_ptr<unsigned char[]>    m_pixels;
-    std::atomic<int> *                  m_task_count;
-    std::atomic<long long> *            m_max_mem_in_queue;
+    SharedPixels                        m_pixels;
+    ImageEncoderSettings                m_encoder;
+    RecordingJournal*                   m_journal;
+    int                                 m_dataChannels;
 
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "journal.h"
+
+#include <sys/stat.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+static long long getFileSize(const std::string& _path) {
+    struct stat st;
+    if (stat(_path.c_str(), &st) != 0)
+        return -1;
+    return (long long)st.st_size;
+}
+
+RecordingJournal::RecordingJournal() : m_file(nullptr), m_resume(false) {
+}
+
+RecordingJournal::~RecordingJournal() {
+    close();
+}
+
+bool RecordingJournal::open(const std::string& _path, bool _resume) {
+    close();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_saved.clear();
+    m_path = _path;
+    m_resume = _resume;
+
+    // each line is "<bytes> <file>", a line cut by a crash (without its newline) is ignored
+    bool torn = false;
+    if (_resume) {
+        std::ifstream in(_path.c_str());
+        std::string line;
+        while (std::getline(in, line)) {
+            torn = in.eof();
+            size_t space = line.find(' ');
+            if (torn || space == std::string::npos || space + 1 >= line.size())
+                continue;
+            m_saved[line.substr(space + 1)] = std::atoll(line.substr(0, space).c_str());
+        }
+    }
+
+    m_file = fopen(_path.c_str(), _resume? "a" : "w");
+    if (!m_file) {
+        std::cerr << "Can't open the journal " << _path << std::endl;
+        return false;
+    }
+
+    // new lines can't be appended to the one that was cut
+    if (torn)
+        fputc('\n', m_file);
+    return true;
+}
+
+void RecordingJournal::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+void RecordingJournal::add(const std::string& _file) {
+    long long size = getFileSize(_file);
+    if (size <= 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file)
+        return;
+
+    m_saved[_file] = size;
+    fprintf(m_file, "%lld %s\n", size, _file.c_str());
+    fflush(m_file);
+}
+
+bool RecordingJournal::isComplete(const std::vector<std::string>& _files) const {
+    if (_files.size() == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < _files.size(); i++) {
+        std::map<std::string, long long>::const_iterator it = m_saved.find(_files[i]);
+        if (it == m_saved.end() || getFileSize(_files[i]) != it->second)
+            return false;
+    }
+    return true;
+}
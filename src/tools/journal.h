@@ -0,0 +1,37 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+/** Keeps track on disk of the files of a sequence that are completely saved, so an
+ *  interrupted render can be resumed. Files are appended (with their size) once they
+ *  are written, from any of the saving threads. Resuming loads the previous journal
+ *  and frames whose files are all there, with the same size, can be skipped **/
+class RecordingJournal {
+public:
+    RecordingJournal();
+    virtual ~RecordingJournal();
+
+    bool    open(const std::string& _path, bool _resume);
+    void    close();
+
+    bool    isOpen() const { std::lock_guard<std::mutex> lock(m_mutex); return m_file != nullptr; }
+    bool    isResuming() const { std::lock_guard<std::mutex> lock(m_mutex); return m_file != nullptr && m_resume; }
+    std::string getPath() const { std::lock_guard<std::mutex> lock(m_mutex); return m_path; }
+
+    // Record _file as saved
+    void    add(const std::string& _file);
+
+    // True if all _files were saved before and are still on disk with the same size
+    bool    isComplete(const std::vector<std::string>& _files) const;
+
+private:
+    mutable std::mutex                  m_mutex;
+    std::map<std::string, long long>    m_saved;
+    std::string                         m_path;
+    FILE*                               m_file;
+    bool                                m_resume;
+};
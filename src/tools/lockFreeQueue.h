@@ -1,44 +1,93 @@
 #pragma once
 
-#include <list>
-#include <iterator>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <condition_variable>
 
-using Pixels        = std::unique_ptr<unsigned char[]>;
+#include "framePool.h"
 
+enum QueuePolicy {
+    QUEUE_BLOCK = 0,    // the producer waits for the consumer to free a slot
+    QUEUE_DROP          // frames that don't fit are dropped
+};
+
+/** Bounded single-producer/single-consumer ring of frames. Slots are preallocated,
+ *  so producing and consuming never touch the allocator. Only one thread can
+ *  produce and only one thread can consume. A blocked producer sleeps until the
+ *  consumer frees a slot, the mutex is only taken when one is waiting **/
 class LockFreeQueue {
 public:
 
-    LockFreeQueue() {
-        // Add one to validate the iterators
-        m_list.push_back( Pixels() );
-        m_headIt = m_list.begin();
-        m_tailIt = m_list.end();
+    LockFreeQueue(size_t _capacity = 16, QueuePolicy _policy = QUEUE_BLOCK) :
+        m_policy(_policy), m_head(0), m_tail(0), m_dropped(0), m_waiting(false) {
+        setCapacity(_capacity);
     }
 
-    void produce( std::unique_ptr<unsigned char[]>&& t ) {
-        m_list.push_back( std::move(t) );
-        m_tailIt = m_list.end();
-        m_list.erase( m_list.begin(), m_headIt );
+    // Only safe while nobody is producing or consuming
+    void setCapacity( size_t _capacity ) {
+        m_slots.clear();
+        m_slots.resize( (_capacity > 0)? _capacity : 1 );
+        m_head = 0;
+        m_tail = 0;
+        m_dropped = 0;
     }
 
-    bool consume( std::unique_ptr<unsigned char[]>&& t ) {
-        typename PixelList::iterator nextIt = m_headIt;
-        ++nextIt;
-        if ( nextIt != m_tailIt ) {
-            m_headIt = nextIt;
-            t        = std::move( *m_headIt );
-            return true;
+    void setPolicy( QueuePolicy _policy ) { m_policy = _policy; }
+
+    bool produce( SharedPixels&& _pixels ) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if ( tail - m_head.load(std::memory_order_acquire) >= m_slots.size() ) {
+            if (m_policy == QUEUE_DROP) {
+                m_dropped++;
+                return false;
+            }
+
+            // flag it before looking at the head again, so consume() can't miss it
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_waiting = true;
+            m_space.wait(lock, [this, tail]{ return tail - m_head.load() < m_slots.size(); });
+            m_waiting = false;
         }
 
-        return false;
+        m_slots[tail % m_slots.size()] = std::move(_pixels);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool consume( SharedPixels& _pixels ) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if ( head == m_tail.load(std::memory_order_acquire) )
+            return false;
+
+        _pixels = std::move( m_slots[head % m_slots.size()] );
+        m_head.store(head + 1);
+
+        if (m_waiting.load()) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_space.notify_one();
+        }
+        return true;
     }
 
-    int size() const { return std::distance( m_headIt, m_tailIt ) - 1; }
-    typename std::list<Pixels>::iterator getHead() const { return m_headIt; }
-    typename std::list<Pixels>::iterator getTail() const { return m_tailIt; }
+    size_t size() const { 
+        size_t head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+    size_t getCapacity() const { return m_slots.size(); }
+    size_t getDropped() const { return m_dropped.load(); }
+    QueuePolicy getPolicy() const { return m_policy; }
 
 private:
-    using PixelList = std::list<Pixels>;
-    PixelList                       m_list;
-    typename PixelList::iterator    m_headIt, m_tailIt;
+    std::vector<SharedPixels>   m_slots;
+    QueuePolicy             m_policy;
+    std::atomic<size_t>     m_head;     // next slot to consume, only written by the consumer
+    std::atomic<size_t>     m_tail;     // next slot to produce, only written by the producer
+    std::atomic<size_t>     m_dropped;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_space;    // a slot was freed
+    std::atomic<bool>       m_waiting;  // the producer is blocked on a full ring
 };
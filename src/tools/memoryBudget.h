@@ -0,0 +1,49 @@
+#pragma once
+
+#include <mutex>
+#include <cstddef>
+
+/** Keeps track of how many bytes of captured frames are waiting to be saved, across all
+ *  capture formats. The render thread checks for room before rendering a new frame
+ *  (holding the clock otherwise), saving threads release it once the frame is on disk. A single job
+ *  always fits, so frames bigger than the limit still go through one at a time **/
+class MemoryBudget {
+public:
+    MemoryBudget(long long _limit = 500 * 1024 * 1024) : m_limit(_limit), m_inFlight(0), m_jobs(0) {}
+
+    void setLimit( long long _limit ) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_limit = _limit;
+    }
+
+    // True if _bytes more would fit right now
+    bool fits( size_t _bytes ) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return _fits(_bytes);
+    }
+
+    // Account for a new job, even if it doesn't fit
+    void reserve( size_t _bytes ) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlight += _bytes;
+        m_jobs++;
+    }
+
+    void release( size_t _bytes ) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlight -= _bytes;
+        m_jobs--;
+    }
+
+    long long   getLimit() const { std::lock_guard<std::mutex> lock(m_mutex); return m_limit; }
+    long long   getInFlight() const { std::lock_guard<std::mutex> lock(m_mutex); return m_inFlight; }
+    size_t      getJobs() const { std::lock_guard<std::mutex> lock(m_mutex); return m_jobs; }
+
+private:
+    bool _fits( size_t _bytes ) const { return m_jobs == 0 || m_inFlight + (long long)_bytes <= m_limit; }
+
+    mutable std::mutex          m_mutex;
+    long long                   m_limit;
+    long long                   m_inFlight;
+    size_t                      m_jobs;
+};
@@ -0,0 +1,175 @@
+#include "pixelBufferRing.h"
+
+#include <iostream>
+#include <utility>
+
+// Asynchronous readbacks need PBOs and fences (GL 3.2+ / GLES 3.0+). WebGL2 can't map buffers.
+#if defined(GL_PIXEL_PACK_BUFFER) && defined(GL_SYNC_GPU_COMMANDS_COMPLETE) && !defined(__EMSCRIPTEN__)
+#define PBO_READBACK
+#endif
+
+int PixelsRequest::getChannels() const {
+    if (format == GL_RGBA)
+        return 4;
+    else if (format == GL_RGB)
+        return 3;
+    else if (format == GL_RED || format == GL_DEPTH_COMPONENT)
+        return 1;
+    return 4;
+}
+
+size_t PixelsRequest::getBytes() const {
+    size_t bytesPerChannel = (type == GL_FLOAT)? sizeof(float) : 1;
+    return (size_t)width * (size_t)height * getChannels() * bytesPerChannel;
+}
+
+PixelBufferRing::PixelBufferRing() : m_depth(3), m_frame(0), m_frameBytes(0), m_openBytes(0) {
+}
+
+PixelBufferRing::~PixelBufferRing() {
+    // GL objects are owned by the context, which is usually gone by now.
+}
+
+void PixelBufferRing::setDepth(size_t _depth) {
+    // Frames already in flight are handed over by the next endFrame() or flush()
+    m_depth = _depth;
+}
+
+size_t PixelBufferRing::getPending() const {
+    size_t frames = 0;
+    for (size_t i = 0; i < m_inflight.size(); i++)
+        if (i == 0 || m_inflight[i].frame != m_inflight[i-1].frame)
+            frames++;
+    return frames;
+}
+
+size_t PixelBufferRing::getPendingBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < m_inflight.size(); i++)
+        bytes += m_inflight[i].request.getBytes();
+    return bytes;
+}
+
+void PixelBufferRing::read(const PixelsRequest& _request, PixelsCallback _callback) {
+    size_t bytes = _request.getBytes();
+    m_openBytes += bytes;
+
+    GLint alignment = 4;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    #if defined(PBO_READBACK)
+    if (m_depth >= 2) {
+        // reuse a buffer big enough for it if there is one, otherwise grow (or create) one
+        Slot slot;
+        if (m_free.size() > 0) {
+            size_t pick = m_free.size() - 1;
+            for (size_t i = 0; i < m_free.size(); i++)
+                if (m_free[i].capacity >= bytes) {
+                    pick = i;
+                    break;
+                }
+            slot = std::move(m_free[pick]);
+            m_free.erase(m_free.begin() + pick);
+        }
+        else
+            glGenBuffers(1, &slot.pbo);
+
+        slot.request = _request;
+        slot.callback = _callback;
+        slot.frame = m_frame;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        if (slot.capacity < bytes) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            slot.capacity = bytes;
+        }
+        glReadPixels(0, 0, _request.width, _request.height, _request.format, _request.type, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = (void*)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_inflight.push_back(std::move(slot));
+
+        glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+        return;
+    }
+    #endif
+
+    m_buffer.resize( bytes );
+    glReadPixels(0, 0, _request.width, _request.height, _request.format, _request.type, m_buffer.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    _callback(_request, m_buffer.data());
+}
+
+void PixelBufferRing::endFrame() {
+    m_frameBytes = m_openBytes;
+    m_openBytes = 0;
+    m_frame++;
+
+    // Hand over the frames that are N-1 frames old
+    size_t keep = (m_depth >= 2)? m_depth - 1 : 0;
+    while (getPending() > keep)
+        _consume();
+}
+
+void PixelBufferRing::flush() {
+    while (m_inflight.size() > 0)
+        _consume();
+}
+
+void PixelBufferRing::clear() {
+    flush();
+
+    #if defined(PBO_READBACK)
+    for (size_t i = 0; i < m_free.size(); i++)
+        if (m_free[i].pbo)
+            glDeleteBuffers(1, &m_free[i].pbo);
+    #endif
+
+    m_free.clear();
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+    m_frameBytes = 0;
+    m_openBytes = 0;
+}
+
+// Hand over every read of the oldest frame in flight
+void PixelBufferRing::_consume() {
+    if (m_inflight.size() == 0)
+        return;
+
+    size_t frame = m_inflight.front().frame;
+    while (m_inflight.size() > 0 && m_inflight.front().frame == frame) {
+        Slot slot = std::move(m_inflight.front());
+        m_inflight.pop_front();
+
+        #if defined(PBO_READBACK)
+        // Wait for the GPU to finish writing into this buffer before reusing it
+        GLsync fence = (GLsync)slot.fence;
+        if (fence) {
+            GLenum status = GL_TIMEOUT_EXPIRED;
+            while (status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+            if (status == GL_WAIT_FAILED)
+                std::cerr << "Error waiting for the pixels readback fence" << std::endl;
+
+            glDeleteSync(fence);
+            slot.fence = nullptr;
+        }
+
+        size_t bytes = slot.request.getBytes();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        if (data) {
+            slot.callback(slot.request, data);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        else
+            std::cerr << "Error mapping the pixels readback buffer" << std::endl;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        #endif
+
+        slot.callback = nullptr;
+        m_free.push_back(std::move(slot));
+    }
+}
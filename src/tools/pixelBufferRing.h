@@ -0,0 +1,79 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+#include "vera/gl/gl.h"
+
+/** Describes a region of the bound framebuffer to read back **/
+struct PixelsRequest {
+    PixelsRequest() {}
+    PixelsRequest(int _width, int _height, GLenum _format, GLenum _type) :
+        width(_width), height(_height), format(_format), type(_type) {}
+
+    int     getChannels() const;
+    size_t  getBytes() const;
+
+    int     width   = 0;
+    int     height  = 0;
+    GLenum  format  = GL_RGBA;
+    GLenum  type    = GL_UNSIGNED_BYTE;
+};
+
+typedef std::function<void(const PixelsRequest&, const void*)> PixelsCallback;
+
+/** Ring of pixel buffer objects, N frames deep. Every read is issued asynchronously and
+ *  belongs to the frame being captured, which is closed with endFrame(). Reads are handed
+ *  to their callbacks a whole frame at a time, N-1 frames later, once the fences guarding
+ *  them have been signaled, so a frame can read as many buffers as it needs without
+ *  waiting on itself. A depth lower than 2 (or a GL context without PBOs/fences) falls
+ *  back to a synchronous glReadPixels **/
+class PixelBufferRing {
+public:
+    PixelBufferRing();
+    virtual ~PixelBufferRing();
+
+    void    setDepth(size_t _depth);
+    size_t  getDepth() const { return m_depth; }
+
+    // Frames (closed or not) with reads in flight
+    size_t  getPending() const;
+    // Bytes of the reads in flight
+    size_t  getPendingBytes() const;
+    // Bytes read by the last closed frame
+    size_t  getFrameBytes() const { return m_frameBytes; }
+
+    // Read from the currently bound framebuffer as part of the current frame
+    void    read(const PixelsRequest& _request, PixelsCallback _callback);
+
+    // Close the current frame, handing over the frames that are N-1 frames old
+    void    endFrame();
+
+    // Hand over all the pending reads (blocks until the GPU finishes them)
+    void    flush();
+
+    // Release the GL buffers (pending reads are flushed first)
+    void    clear();
+
+private:
+    struct Slot {
+        PixelsRequest   request;
+        PixelsCallback  callback;
+        GLuint          pbo         = 0;
+        size_t          capacity    = 0;
+        void*           fence       = nullptr;
+        size_t          frame       = 0;
+    };
+
+    void                _consume();
+
+    std::deque<Slot>            m_inflight;
+    std::vector<Slot>           m_free;     // buffers ready to be reused, keeping their capacity
+    std::vector<unsigned char>  m_buffer;   // used by the synchronous fallback
+    size_t                      m_depth;
+    size_t                      m_frame;
+    size_t                      m_frameBytes;
+    size_t                      m_openBytes;
+};
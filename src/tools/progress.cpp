@@ -0,0 +1,144 @@
+#include "progress.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+
+using Clock = std::chrono::steady_clock;
+
+static std::mutex               progress_mutex;
+static std::condition_variable  progress_changed;
+static RecordingProgress        progress;
+static std::deque<int>          progress_pending;       // sinks still to finish each queued frame, oldest first
+static int                      progress_finished = 0;  // outputs done that don't complete the oldest frame yet
+static int                      progress_outputs = 0;
+static bool                     progress_rendering = false;
+static Clock::time_point        progress_start;
+static Clock::time_point        progress_renderEnd;
+static std::string              progress_watch;
+
+static long long getFileSize(const std::string& _path) {
+    struct stat st;
+    if (_path.empty() || stat(_path.c_str(), &st) != 0)
+        return 0;
+    return (long long)st.st_size;
+}
+
+// frames leave the queue in order, once all their sinks are done. Needs progress_mutex
+static void drain() {
+    while (progress_pending.size() > 0 && progress_pending.front() <= progress_finished) {
+        progress_finished -= progress_pending.front();
+        progress_pending.pop_front();
+        progress.encoded++;
+    }
+    progress.queued = (int)progress_pending.size();
+    progress.done = !progress_rendering && progress_pending.empty();
+    progress.id++;
+}
+
+void progressStart(int _total) {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    uint64_t id = progress.id;
+    progress = RecordingProgress();
+    progress.id = id + 1;
+    progress.total = std::max(0, _total);
+    progress.done = false;
+    progress_pending.clear();
+    progress_finished = 0;
+    progress_outputs = 0;
+    progress_rendering = true;
+    progress_start = Clock::now();
+    progress_watch = "";
+    progress_changed.notify_all();
+}
+
+void progressFrameOutputs(int _outputs) {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    progress_outputs = std::max(0, _outputs);
+}
+
+void progressFrameRendered(bool _last) {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    if (!progress_rendering)
+        return;
+
+    progress.rendered++;
+    progress_pending.push_back(progress_outputs);
+    progress_outputs = 0;
+
+    if (_last) {
+        progress_rendering = false;
+        progress_renderEnd = Clock::now();
+    }
+
+    drain();
+    progress_changed.notify_all();
+}
+
+void progressOutputDone(size_t _bytes) {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    if (progress.done)
+        return;
+
+    progress.bytes += _bytes;
+    progress_finished++;
+    drain();
+    progress_changed.notify_all();
+}
+
+void progressFileDone(const std::string& _file) {
+    progressOutputDone( (size_t)getFileSize(_file) );
+}
+
+void progressWatchFile(const std::string& _file) {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    progress_watch = _file;
+}
+
+// Needs progress_mutex
+static RecordingProgress snapshot() {
+    RecordingProgress rta = progress;
+    rta.bytes += getFileSize(progress_watch);
+
+    Clock::time_point now = Clock::now();
+    float elapsed = std::chrono::duration<float>(now - progress_start).count();
+    float renderElapsed = progress_rendering? elapsed : std::chrono::duration<float>(progress_renderEnd - progress_start).count();
+
+    if (renderElapsed > 0.0f)
+        rta.renderFps = rta.rendered / renderElapsed;
+    if (elapsed > 0.0f)
+        rta.encodeFps = rta.encoded / elapsed;
+
+    // whichever end is slower sets the pace
+    if (rta.done)
+        rta.eta = 0.0f;
+    else if (rta.renderFps > 0.0f && rta.encodeFps > 0.0f)
+        rta.eta = std::max( (rta.total - rta.rendered) / rta.renderFps, (rta.total - rta.encoded) / rta.encodeFps );
+    return rta;
+}
+
+RecordingProgress getProgress() {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    return snapshot();
+}
+
+bool waitProgress(RecordingProgress& _progress, uint64_t _after, int _timeoutMs) {
+    std::unique_lock<std::mutex> lock(progress_mutex);
+    bool changed = progress_changed.wait_for(lock, std::chrono::milliseconds(_timeoutMs), [_after]{ return progress.id != _after; });
+    _progress = snapshot();
+    return changed;
+}
+
+std::string toString(const RecordingProgress& _progress) {
+    std::ostringstream line;
+    line << "progress," << _progress.rendered << "," << _progress.total << "," << _progress.encoded << "," << _progress.queued << ",";
+    line.setf(std::ios::fixed);
+    line.precision(2);
+    line << _progress.renderFps << "," << _progress.encodeFps << "," << _progress.eta << "," << _progress.bytes;
+    return line.str();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/** Progress of a recording (sequence, secs, frames or record). Frames are counted as they are
+ *  rendered and again once every sink they go to (image files, video, stream) is done with them.
+ *  Each change wakes up whoever waits for it, so progress is pushed instead of polled **/
+struct RecordingProgress {
+    uint64_t    id          = 0;        // changes with every event
+    int         total       = 0;        // frames to render
+    int         rendered    = 0;
+    int         encoded     = 0;        // frames all their sinks are done with
+    int         queued      = 0;        // rendered frames still waiting for their sinks
+    float       renderFps   = 0.0f;
+    float       encodeFps   = 0.0f;
+    float       eta         = -1.0f;    // seconds, negative while unknown
+    uint64_t    bytes       = 0;
+    bool        done        = true;
+};
+
+void    progressStart(int _total);
+
+// Number of sinks the frame being rendered goes to, taken by progressFrameRendered
+void    progressFrameOutputs(int _outputs);
+void    progressFrameRendered(bool _last);
+
+// A sink is done with a frame, after writing _bytes (zero if it failed or dropped it)
+void    progressOutputDone(size_t _bytes);
+void    progressFileDone(const std::string& _file);
+
+// The size of this file is added to the bytes written (for encoders that write it themselves)
+void    progressWatchFile(const std::string& _file);
+
+RecordingProgress   getProgress();
+
+// Waits up to _timeoutMs for a progress newer than _after, false if nothing changed
+bool    waitProgress(RecordingProgress& _progress, uint64_t _after, int _timeoutMs);
+
+// As a line of the console protocol: progress,<rendered>,<total>,<encoded>,<queued>,<render_fps>,<encode_fps>,<eta>,<bytes>
+std::string toString(const RecordingProgress& _progress);
@@ -4,15 +4,22 @@
 #include <string.h>
 
 #include <cstdio>
+#include <algorithm>
+#include <cmath>
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 #include "vera/ops/fs.h"
 #include "vera/ops/string.h"
 
 #include "lockFreeQueue.h"
+#include "videoEncoder.h"
+#include "yuv420.h"
 #include "console.h"
+#include "progress.h"
 
 #if defined( _WIN32 )
 #define P_CLOSE( file ) _pclose( file )
@@ -37,6 +44,11 @@ size_t frame_head = 0;
 size_t frame_end = 0;
 bool   frame = false;
 
+// SUB-FRAMES
+int    sub_total = 1;
+int    sub_head = 0;
+float  sub_shutter = 1.0f;
+
 #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
 
 // Video by Seconds
@@ -45,6 +57,7 @@ using TimePoint     = std::chrono::time_point<Clock>;
 using Seconds       = std::chrono::duration<float>;
 
 FILE*                       pipe = nullptr;
+VideoEncoder                pipe_encoder;           // in-process alternative to the ffmpeg pipe
 std::atomic<bool>           pipe_isRecording;
 std::thread                 pipe_thread;
 RecordingSettings           pipe_settings;
@@ -52,8 +65,36 @@ RecordingSettings           pipe_settings;
 TimePoint                   pipe_start;
 TimePoint                   pipe_lastFrame;
 LockFreeQueue               pipe_frames;
+std::mutex                  pipe_mutex;
+std::condition_variable     pipe_wakeup;            // new frames or end of the recording
+
+// Wake up the consumer thread
+void pipeNotify() {
+    std::lock_guard<std::mutex> lock( pipe_mutex );
+    pipe_wakeup.notify_one();
+}
+
+bool recordingPipe() { return ((pipe != nullptr || pipe_encoder.isOpen()) && pipe_isRecording.load()); }
 
-bool recordingPipe() { return (pipe != nullptr && pipe_isRecording.load()); }
+// False while a new frame wouldn't fit in the queue, so the render loop can hold the clock
+// instead of blocking on the encoder. Each readback hands over at most one frame
+bool recordingPipeReady() { 
+    if ( !recordingPipe() || pipe_frames.getPolicy() == QUEUE_DROP )
+        return true;
+    return pipe_frames.size() < pipe_frames.getCapacity();
+}
+
+bool recordingPipeYUV() { return recordingPipe() && pipe_settings.src_yuv; }
+bool recordingPipeRGBA() { return recordingPipe() && !pipe_settings.src_yuv && pipe_settings.src_channels == 4; }
+
+// size of the frame inside those buffers
+size_t recordingPipeFrameBytes() {
+    if ( pipe_settings.src_yuv )
+        return getYUV420Bytes( pipe_settings.src_width, pipe_settings.src_height );
+    return pipe_settings.src_width * pipe_settings.src_height * pipe_settings.src_channels;
+}
+
+void processFrame();
 
 // From https://github.com/tyhenry/ofxFFmpeg
 bool recordingPipeOpen(const RecordingSettings& _settings, float _start, float _end) {
@@ -67,6 +108,10 @@ bool recordingPipeOpen(const RecordingSettings& _settings, float _start, float _
         return false;
     }
 
+    // make sure the previous recording is completely closed
+    if ( pipe_thread.joinable() ) 
+        pipe_thread.join();
+
     pipe_settings = _settings;
     if ( pipe_settings.trg_path.empty() ) {
         std::cerr << "Can't start recording - output path is not set!" << std::endl;
@@ -92,6 +137,13 @@ bool recordingPipeOpen(const RecordingSettings& _settings, float _start, float _
     if ( pipe_settings.ffmpegPath.empty() )
         pipe_settings.ffmpegPath = "ffmpeg";
 
+    // YUV420 needs even dimensions
+    if ( pipe_settings.src_width % 2 != 0 || pipe_settings.src_height % 2 != 0 )
+        pipe_settings.src_yuv = false;
+
+    pipe_frames.setCapacity( pipe_settings.queue_capacity );
+    pipe_frames.setPolicy( pipe_settings.queue_policy );
+
     fdelta = 1.0/pipe_settings.src_fps;
     counter = 0;
 
@@ -99,96 +151,143 @@ bool recordingPipeOpen(const RecordingSettings& _settings, float _start, float _
     sec_head = _start;
     sec_end = _end;
 
-    std::string cmd = pipe_settings.ffmpegPath;
-    std::vector<std::string> args = {
-        "-y",   // overwrite
-        "-an",                                                  // disable audio -- todo: add audio,`
-
-        #if defined(SUPPORT_NCURSES)
-        "-loglevel quiet",                                      // no log output 
-        // "-stats",                                            // only stats
-        #endif
-
-        // input
-        "-r " + vera::toString( pipe_settings.src_fps ),         // input frame rate
-        "-s " + std::to_string( pipe_settings.src_width ) +     // input resolution width
-            "x" + std::to_string( pipe_settings.src_height ),   // input resolution height
-        "-f rawvideo",                                          // input codec
-        "-pix_fmt rgb24",                                       // input pixel format
-        pipe_settings.src_args,                                 // custom input args
-        "-i pipe:",                                             // input source (default pipe)
-
-        pipe_settings.trg_args,                                 // custom output args
-        pipe_settings.trg_path                                  // output path
-    };
-
-    for ( size_t i = 0; i < args.size(); i++)
-        if ( !args[i].empty() ) 
-            cmd += " " + args[i];
-
-    // std::cout << cmd << std::endl; 
-
-    if ( pipe != nullptr )
-        P_CLOSE( pipe );
+    if ( pipe_settings.libav ) {
+        if ( !pipe_encoder.open( pipe_settings.trg_path, 
+                                 pipe_settings.src_width, pipe_settings.src_height, 
+                                 pipe_settings.src_yuv? VIDEO_YUV420 : ((pipe_settings.src_channels == 4)? VIDEO_RGBA : VIDEO_RGB),
+                                 pipe_settings.src_fps,
+                                 pipe_settings.trg_width, pipe_settings.trg_height, pipe_settings.trg_fps,
+                                 pipe_settings.trg_codec ) ) {
+            std::cerr << "Unable to start recording." << std::endl;
+            return false;
+        }
+    }
+    else {
+        std::string cmd = pipe_settings.ffmpegPath;
+        std::vector<std::string> args = {
+            "-y",   // overwrite
+            "-an",                                                  // disable audio -- todo: add audio,`
+
+            #if defined(SUPPORT_NCURSES)
+            "-loglevel quiet",                                      // no log output 
+            // "-stats",                                            // only stats
+            #endif
+
+            // input
+            "-r " + vera::toString( pipe_settings.src_fps ),         // input frame rate
+            "-s " + std::to_string( pipe_settings.src_width ) +     // input resolution width
+                "x" + std::to_string( pipe_settings.src_height ),   // input resolution height
+            "-f rawvideo",                                          // input codec
+            pipe_settings.src_yuv? "-pix_fmt yuv420p" :             // input pixel format
+                ((pipe_settings.src_channels == 4)? "-pix_fmt rgba" : "-pix_fmt rgb24"),
+            pipe_settings.src_args,                                 // custom input args
+            "-i pipe:",                                             // input source (default pipe)
+
+            pipe_settings.trg_args,                                 // custom output args
+            pipe_settings.trg_path                                  // output path
+        };
+
+        for ( size_t i = 0; i < args.size(); i++)
+            if ( !args[i].empty() ) 
+                cmd += " " + args[i];
+
+        // std::cout << cmd << std::endl; 
+
+        if ( pipe != nullptr )
+            P_CLOSE( pipe );
+
+        pipe = P_OPEN( cmd.c_str() );
+
+        if ( !pipe ) {
+            // // get error string from 'errno' code
+            // char errmsg[500];
+            // std::strerror_s( errmsg, 500, errno );
+            // std::cerr << "Unable to start recording. Error: " << errmsg << std::endl;
 
-    pipe = P_OPEN( cmd.c_str() );
+            std::cerr << "Unable to start recording." << std::endl;
+            return false;
+        }
+    }
 
-    if ( !pipe ) {
-        // // get error string from 'errno' code
-        // char errmsg[500];
-        // std::strerror_s( errmsg, 500, errno );
-        // std::cerr << "Unable to start recording. Error: " << errmsg << std::endl;
+    progressStart( (int)std::ceil((sec_end - sec_start) / fdelta - 0.0001f) );
+    progressWatchFile( pipe_settings.trg_path );
+    pipe_isRecording = true;
 
-        std::cerr << "Unable to start recording." << std::endl;
-        return false;
-    }
+    // Frames can reach the pipe a few renders after they were requested (async readbacks),
+    // so the consumer thread needs to be up before the first one lands
+    pipe_thread     = std::thread( &processFrame );
+    pipe_start      = Clock::now();
+    pipe_lastFrame  = pipe_start;
 
-    return pipe_isRecording = true;
+    return true;
 }
 
 void processFrame() {
-    while ( pipe_isRecording.load() ) {
+    TimePoint lastFrameTime = Clock::now();
+    const Seconds framedur( 1.f / pipe_settings.src_fps );
+
+    while ( true ) {
+        {
+            // sleep until there is a frame to write or the recording is over
+            std::unique_lock<std::mutex> lock( pipe_mutex );
+            pipe_wakeup.wait( lock, []{ return pipe_frames.size() > 0 || !pipe_isRecording.load(); } );
+        }
 
-        TimePoint lastFrameTime = Clock::now();
-        const float framedur    = 1.f / pipe_settings.src_fps;
+        // allows finish processing queue after we call stop()
+        if ( pipe_frames.size() == 0 )
+            break;
 
-        while ( pipe_frames.size() ) {  // allows finish processing queue after we call stop()
+        if ( !pipe_isRecording.load() ) {
+            console_clear();
+            std::cout << "Don't close. Recording stopped, but still processing " << pipe_frames.size() << " frames" << std::endl;
+            console_refresh();
+        }
 
-            // feed frames at constant fps
-            float delta = Seconds( Clock::now() - lastFrameTime ).count();
+        // live captures can ask for frames to be fed at a constant fps,
+        // otherwise they go as fast as the encoder takes them
+        if ( pipe_settings.realtime )
+            std::this_thread::sleep_until( lastFrameTime + std::chrono::duration_cast<Clock::duration>(framedur) );
 
-            if ( delta >= framedur ) {
-                
-                if ( !pipe_isRecording.load() ) {
-                    console_clear();
-                    std::cout << "Don't close. Recording stopped, but still processing " << pipe_frames.size() << " frames" << std::endl;
-                }
+        SharedPixels data;
+        if ( pipe_frames.consume( data ) && data ) {
+            const size_t dataLength = recordingPipeFrameBytes();
+            size_t written = 0;
+            if ( pipe_encoder.isOpen() )
+                written = pipe_encoder.encode( data.get() )? dataLength : 0;
+            else if ( pipe )
+                written = fwrite( data.get(), sizeof( char ), dataLength, pipe );
 
-                Pixels pixels;
-                if ( pipe_frames.consume( std::move( pixels ) ) && pixels ) {
-                    std::unique_ptr<unsigned char[]> data = std::move( pixels );
-                    const size_t dataLength = pipe_settings.src_width * pipe_settings.src_height * pipe_settings.src_channels;
-                    const size_t written = pipe ? fwrite( data.get(), sizeof( char ), dataLength, pipe ) : 0;
+            if ( written <= 0 )
+                std::cout << "Unable to write the frame." << std::endl;
 
-                    if ( written <= 0 )
-                        std::cout << "Unable to write the frame." << std::endl;
+            // what's written is counted from the size of the file
+            progressOutputDone( 0 );
 
-                    lastFrameTime = Clock::now();
-                }
+            // the last owner of the frame gives it back
+            data.reset();
 
-                console_refresh();
-            }
+            lastFrameTime = Clock::now();
         }
+    }
 
-        console_clear();
-        std::cout << "Don't close. Encoding data into " << pipe_settings.trg_path << std::endl;
-        console_refresh();
+    console_clear();
+    std::cout << "Don't close. Encoding data into " << pipe_settings.trg_path << std::endl;
+    console_refresh();
 
-    }
     // close ffmpeg pipe once stopped recording
     
-    
-    if ( pipe ) {
+    if ( pipe_encoder.isOpen() ) {
+        console_clear();
+        if ( !pipe_encoder.close() )
+            std::cerr << "Error closing the video encoder." << std::endl;
+        else 
+            std::cout << "Finish saving " << pipe_settings.trg_path << std::endl;
+
+        if ( pipe_frames.getDropped() > 0 )
+            std::cout << pipe_frames.getDropped() << " frames were dropped because the encoder couldn't keep up" << std::endl;
+        console_refresh();
+    }
+    else if ( pipe ) {
         console_clear();
         if ( P_CLOSE( pipe ) < 0 ) {
             // // get error string from 'errno' code
@@ -199,6 +298,9 @@ void processFrame() {
         }
         else 
             std::cout << "Finish saving " << pipe_settings.trg_path << std::endl;
+
+        if ( pipe_frames.getDropped() > 0 )
+            std::cout << pipe_frames.getDropped() << " frames were dropped because the encoder couldn't keep up" << std::endl;
         console_refresh();
     }
     
@@ -206,25 +308,25 @@ void processFrame() {
     counter = 0;
 }
 
-size_t recordingPipeFrame( std::unique_ptr<unsigned char[]>&& _pixels ) {
+size_t recordingPipeFrame( SharedPixels _pixels ) {
     if ( !pipe_isRecording ) {
         std::cerr << "Can't add new frame - not in recording mode." << std::endl;
+        progressOutputDone( 0 );
         return 0;
     }
 
-    if ( !pipe ) {
+    if ( !pipe && !pipe_encoder.isOpen() ) {
         std::cerr << "Can't add new frame - FFmpeg pipe is invalid!" << std::endl;
+        progressOutputDone( 0 );
         return 0;
     }
 
-    if ( counter == 0 ) {
-        if ( pipe_thread.joinable() ) pipe_thread.join();  //detach();
-        pipe_thread     = std::thread( &processFrame );
-        pipe_start      = Clock::now();
-        pipe_lastFrame  = pipe_start;
+    if ( !pipe_frames.produce( std::move(_pixels) ) ) {
+        progressOutputDone( 0 );
+        return 0;
     }
 
-    pipe_frames.produce( std::move(_pixels) );
+    pipeNotify();
     pipe_lastFrame = Clock::now();
 
     size_t written              = 0;
@@ -260,6 +362,8 @@ size_t recordingPipeFrame( std::unique_ptr<unsigned char[]>&& _pixels ) {
 void recordingPipeClose() {
     frame = false;
     sec = false;
+    pipe_isRecording = false;
+    pipeNotify();
 
     if ( pipe_thread.joinable() ) 
         pipe_thread.join();
@@ -271,6 +375,9 @@ void recordingPipeClose() {
 #else
 
 bool    recordingPipe() { return false; };
+bool    recordingPipeReady() { return true; };
+bool    recordingPipeYUV() { return false; };
+bool    recordingPipeRGBA() { return false; };
 #endif
 
 // ---------------------------------------------------------------------------
@@ -283,6 +390,9 @@ void recordingStartSecs(float _start, float _end, float _fps) {
     sec_head = _start;
     sec_end = _end;
     sec = true;
+    sub_head = 0;
+
+    progressStart( (int)std::ceil((_end - _start) / fdelta - 0.0001f) );
 }
 
 void recordingStartFrames(int _start, int _end, float _fps) {
@@ -293,10 +403,14 @@ void recordingStartFrames(int _start, int _end, float _fps) {
     frame_head = _start;
     frame_end = _end;
     frame = true;
+    sub_head = 0;
+
+    progressStart(_end - _start);
 }
 
 void recordingFrameAdded() {
     counter++;
+    sub_head = 0;
 
     if (sec) {
         sec_head += fdelta;
@@ -306,8 +420,10 @@ void recordingFrameAdded() {
     #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
     else if (recordingPipe()) {
         sec_head += fdelta;
-        if (sec_head >= sec_end)
+        if (sec_head >= sec_end) {
             pipe_isRecording = false;
+            pipeNotify();
+        }
     }
     #endif
     else if (frame) {
@@ -315,10 +431,37 @@ void recordingFrameAdded() {
         if (frame_head >= frame_end)
             frame = false;
     }
+
+    progressFrameRendered( !isRecording() );
+}
+
+void setRecordingSubframes(int _subframes, float _shutter) {
+    sub_total = std::max(1, _subframes);
+    sub_shutter = std::max(0.0f, std::min(_shutter, 1.0f));
+    sub_head = 0;
 }
 
+int getRecordingSubframes() { return sub_total; }
+int getRecordingSubframe() { return std::min(sub_head, sub_total - 1); }
+float getRecordingShutter() { return sub_shutter; }
+
+void recordingSubframeAdded() {
+    if (sub_head < sub_total)
+        sub_head++;
+}
+
+bool isRecordingFrameComplete() { return sub_head >= sub_total; }
+
 bool isRecording() { return sec || frame || recordingPipe(); }
 
+bool isRecordingLastFrame() {
+    if (sec || recordingPipe())
+        return sec_head + fdelta >= sec_end;
+    else if (frame)
+        return frame_head + 1 >= frame_end;
+    return false;
+}
+
 int getRecordingCount() { return counter; }
 float getRecordingDelta() { return fdelta; }
 
@@ -341,8 +484,13 @@ int getRecordingFrame() {
 }
 
 float getRecordingTime() {
+    // sub-frames sample the middle of equal slices of the shutter
+    float offset = 0.0f;
+    if (sub_total > 1)
+        offset = fdelta * sub_shutter * ((getRecordingSubframe() + 0.5f) / sub_total - 0.5f);
+
     if (sec || recordingPipe() )
-        return sec_head;
+        return sec_head + offset;
     else
-        return frame_head * fdelta;
+        return frame_head * fdelta + offset;
 }
@@ -3,6 +3,10 @@
 #include <string>
 #include <memory>
 
+#include "lockFreeQueue.h"
+#include "framePool.h"
+#include "videoEncoder.h"
+
 #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
 struct RecordingSettings {
     std::string ffmpegPath      = "ffmpeg";
@@ -10,6 +14,7 @@ struct RecordingSettings {
     size_t      src_width       = 512;
     size_t      src_height      = 512;
     size_t      src_channels    = 3;
+    bool        src_yuv         = true;         // frames come flipped and packed as YUV420 from the GPU (see yuv420.h)
     float       src_fps         = 24.0f;
 
     size_t      trg_width       = 512;
@@ -18,20 +23,40 @@ struct RecordingSettings {
 
     std::string trg_args        = "-pix_fmt yuv420p -vsync 1 -g 1";  // -crf 0 -preset ultrafast -tune zerolatency setpts='(RTCTIME - RTCSTART) / (TB * 1000000)'
     std::string trg_path        = "output.mp4";
+    VideoCodecSettings trg_codec;               // also passed to ffmpeg through trg_args (see record in main.cpp)
+
+    bool        libav           = false;        // encode in-process instead of piping raw frames to ffmpeg (see record_encoder)
+
+    size_t      queue_capacity  = 16;           // frames waiting to be encoded
+    QueuePolicy queue_policy    = QUEUE_BLOCK;  // what to do when they don't fit
+    bool        realtime        = false;        // feed frames at src_fps (live capture) instead of as fast as possible
 };
 
 bool    recordingPipeOpen(const RecordingSettings& _settings, float _start, float _end);
-size_t  recordingPipeFrame( std::unique_ptr<unsigned char[]>&& _pixels );
+size_t  recordingPipeFrame( SharedPixels _pixels );
 void    recordingPipeClose();
 #endif
 bool    recordingPipe();
+bool    recordingPipeReady();
+bool    recordingPipeYUV();
+bool    recordingPipeRGBA();
 
 void    recordingStartSecs(float _start, float _end, float _fps);
 void    recordingStartFrames(int _start, int _end, float _fps);
 
 void    recordingFrameAdded();
 
+// Sub-frames rendered and averaged for each recorded frame (motion blur). Their times are spread
+// over _shutter (0-1) of the frame duration, centered on the frame time
+void    setRecordingSubframes(int _subframes, float _shutter = 1.0f);
+int     getRecordingSubframes();
+int     getRecordingSubframe();
+float   getRecordingShutter();
+void    recordingSubframeAdded();
+bool    isRecordingFrameComplete();
+
 bool    isRecording();
+bool    isRecordingLastFrame();
 
 float   getRecordingPercentage();
 int     getRecordingCount();
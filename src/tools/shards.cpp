@@ -0,0 +1,202 @@
+#include "shards.h"
+
+#include <sys/stat.h>
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+
+#include "vera/ops/string.h"
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#define SUPPORT_SHARDS
+#endif
+
+bool parseShardRange(const std::string& _command, ShardSettings& _settings) {
+    std::vector<std::string> values = vera::split(_command, ',');
+    if (values.size() < 3)
+        return false;
+
+    float fps = (values.size() >= 4)? vera::toFloat(values[3]) : 24.0f;
+    if (fps <= 0.0f)
+        return false;
+
+    if (values[0] == "frames") {
+        int from = vera::toInt(values[1]);
+        int to = vera::toInt(values[2]);
+        if (from >= to)
+            from = 0;
+        _settings.from = from;
+        _settings.to = to;
+    }
+    else if (values[0] == "sequence" || values[0] == "secs") {
+        float from = vera::toFloat(values[1]);
+        float to = vera::toFloat(values[2]);
+        if (from >= to)
+            from = 0.0f;
+
+        // same frames a single process would render, stepping from the closest frame to <from>
+        _settings.from = (int)std::lround(from * fps);
+        _settings.to = _settings.from + (int)std::ceil((to - from) * fps - 1e-4f);
+    }
+    else
+        return false;
+
+    _settings.fps = fps;
+    return _settings.to > _settings.from;
+}
+
+#if defined(SUPPORT_SHARDS)
+
+struct Shard {
+    int     from        = 0;
+    int     to          = 0;
+    int     attempts    = 0;
+    pid_t   pid         = 0;
+    std::chrono::steady_clock::time_point   start;
+};
+
+// True if all the frames of the shard are on disk
+static bool checkShard(const Shard& _shard, const ShardSettings& _settings) {
+    struct stat st;
+    for (int i = _shard.from; i < _shard.to; i++) {
+        std::string file = vera::toString(i, 0, 5, '0') + "." + _settings.format;
+        if (stat(file.c_str(), &st) != 0 || st.st_size == 0)
+            return false;
+    }
+    return true;
+}
+
+static pid_t launchShard(const std::string& _executable, const Shard& _shard, const ShardSettings& _settings) {
+    std::vector<std::string> args;
+    args.push_back(_executable);
+    args.insert(args.end(), _settings.args.begin(), _settings.args.end());
+    args.push_back("--headless");
+    args.push_back("--noncurses");
+    args.push_back("-e");
+    args.push_back("sequence_numbering,absolute");
+    args.push_back("-E");
+    args.push_back("frames," + vera::toString(_shard.from) + "," + vera::toString(_shard.to) + "," + vera::toString(_settings.fps));
+
+    std::vector<char*> argv;
+    for (size_t i = 0; i < args.size(); i++)
+        argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the worker console would mix with the coordinator's report, errors still go through
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+            close(null);
+        }
+        execvp(argv[0], argv.data());
+        std::cerr << "Can't launch " << _executable << std::endl;
+        _exit(127);
+    }
+    return pid;
+}
+
+int runShards(const std::string& _executable, const ShardSettings& _settings) {
+    int total = _settings.to - _settings.from;
+    int workers = std::max(1, _settings.workers);
+
+    // a few shards per worker balances the load and keeps retries small
+    int frames = _settings.frames;
+    if (frames <= 0)
+        frames = std::max(1, (int)std::ceil((float)total / (float)(workers * 4)));
+
+    std::vector<Shard> shards;
+    for (int i = _settings.from; i < _settings.to; i += frames) {
+        Shard shard;
+        shard.from = i;
+        shard.to = std::min(i + frames, _settings.to);
+        shards.push_back(shard);
+    }
+
+    std::cout << "Rendering frames " << _settings.from << " to " << _settings.to << " in " << shards.size() << " shards on " << workers << " workers" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t next = 0;
+    size_t running = 0;
+    size_t finished = 0;
+    int rendered = 0;
+    bool failed = false;
+
+    while (finished < shards.size()) {
+        // keep every worker busy, failed shards are queued again at the end
+        while (running < (size_t)workers && next < shards.size()) {
+            Shard& shard = shards[next++];
+            shard.attempts++;
+            shard.start = std::chrono::steady_clock::now();
+            shard.pid = launchShard(_executable, shard, _settings);
+            if (shard.pid < 0) {
+                std::cerr << "Can't fork a worker for frames " << shard.from << " to " << shard.to << std::endl;
+                failed = true;
+                finished++;
+                continue;
+            }
+            running++;
+        }
+
+        if (running == 0)
+            break;
+
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid <= 0)
+            break;
+
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (shards[i].pid != pid)
+                continue;
+
+            Shard shard = shards[i];
+            shard.pid = 0;
+            shards[i].pid = 0;
+            running--;
+
+            float secs = std::chrono::duration<float>(std::chrono::steady_clock::now() - shard.start).count();
+            bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && checkShard(shard, _settings);
+
+            if (ok) {
+                finished++;
+                rendered += shard.to - shard.from;
+                float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+                std::cout << "Frames " << shard.from << " to " << shard.to << " done in " << secs << "s, ";
+                std::cout << rendered << "/" << total << " frames at " << (rendered / std::max(elapsed, 0.001f)) << " fps" << std::endl;
+            }
+            else if (shard.attempts <= _settings.retries) {
+                std::cerr << "Frames " << shard.from << " to " << shard.to << " failed, retrying" << std::endl;
+                shards.push_back(shard);
+                finished++;
+            }
+            else {
+                std::cerr << "Frames " << shard.from << " to " << shard.to << " failed after " << shard.attempts << " attempts" << std::endl;
+                failed = true;
+                finished++;
+            }
+            break;
+        }
+    }
+
+    float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    std::cout << rendered << " of " << total << " frames in " << elapsed << "s (" << (rendered / std::max(elapsed, 0.001f)) << " fps)" << std::endl;
+
+    return (failed || rendered < total)? 1 : 0;
+}
+
+#else
+
+int runShards(const std::string&, const ShardSettings&) {
+    std::cerr << "Sharded rendering is not supported on this platform" << std::endl;
+    return 1;
+}
+
+#endif
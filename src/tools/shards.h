@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/** Splits the frames of a sequence in shards rendered by several headless glslViewer
+ *  processes running the same arguments. Frames are rendered with fixed time steps
+ *  (the frames command) and named by their absolute frame number, so the output of
+ *  all the shards lands in the same sequence. Shards that fail, or don't produce all
+ *  their frames, are retried **/
+struct ShardSettings {
+    std::vector<std::string>    args;               // for the workers, without the range command
+    std::string                 format      = "png";
+    int                         from        = 0;    // first frame
+    int                         to          = 0;    // last frame (not included)
+    float                       fps         = 24.0f;
+    int                         workers     = 2;    // processes running at the same time
+    int                         frames      = 0;    // frames per shard (0 = auto)
+    int                         retries     = 2;
+};
+
+// Parses a sequence/secs/frames command into a frame range. Returns false for other commands
+bool    parseShardRange(const std::string& _command, ShardSettings& _settings);
+
+// Runs all the shards with _executable and returns the exit code for the coordinator
+int     runShards(const std::string& _executable, const ShardSettings& _settings);
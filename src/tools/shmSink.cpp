@@ -0,0 +1,147 @@
+#include "shmSink.h"
+
+#include <atomic>
+#include <cstring>
+#include <climits>
+#include <iostream>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define SUPPORT_SHM
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+static const size_t SHM_ALIGN = 64;
+
+static size_t align(size_t _bytes) {
+    return (_bytes + SHM_ALIGN - 1) & ~(SHM_ALIGN - 1);
+}
+
+ShmSink::ShmSink() : m_data(nullptr), m_size(0), m_slotBytes(0), m_slots(0) {
+}
+
+ShmSink::~ShmSink() {
+    close();
+}
+
+#if defined(SUPPORT_SHM)
+
+bool ShmSink::open(const std::string& _name, size_t _frameBytes, int _slots) {
+    close();
+
+    m_name = (_name.size() > 0 && _name[0] == '/')? _name : "/" + _name;
+    m_slots = (_slots > 0)? _slots : 4;
+    m_slotBytes = align(_frameBytes);
+    size_t stride = align(sizeof(ShmFrameHeader)) + m_slotBytes;
+    m_size = align(sizeof(ShmRingHeader)) + stride * m_slots;
+
+    // a previous ring with the same name may have another size, readers still mapping it keep it alive
+    shm_unlink(m_name.c_str());
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Can't open shared memory " << m_name << std::endl;
+        return false;
+    }
+
+    if (ftruncate(fd, m_size) != 0) {
+        std::cerr << "Can't allocate " << m_size << " bytes of shared memory on " << m_name << std::endl;
+        ::close(fd);
+        shm_unlink(m_name.c_str());
+        return false;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "Can't map shared memory " << m_name << std::endl;
+        shm_unlink(m_name.c_str());
+        return false;
+    }
+
+    m_data = (unsigned char*)data;
+    memset(m_data, 0, align(sizeof(ShmRingHeader)));
+
+    ShmRingHeader* header = (ShmRingHeader*)m_data;
+    header->version = 1;
+    header->slots = m_slots;
+    header->slotBytes = m_slotBytes;
+    header->slotStride = stride;
+    for (int i = 0; i < m_slots; i++)
+        memset(m_data + align(sizeof(ShmRingHeader)) + stride * i, 0, sizeof(ShmFrameHeader));
+
+    // the magic goes last, readers can check it to know the ring is ready
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, "GLSLVIEW", 8);
+    return true;
+}
+
+bool ShmSink::publish(const void* _pixels, int _width, int _height, ShmFormat _format, int64_t _frame, double _time) {
+    if (!m_data)
+        return false;
+
+    size_t bytes = (size_t)_width * (size_t)_height * 4;
+    if (bytes > m_slotBytes && !open(m_name, bytes, m_slots))
+        return false;
+
+    ShmRingHeader* header = (ShmRingHeader*)m_data;
+    uint64_t index = header->published;
+    unsigned char* slot = m_data + align(sizeof(ShmRingHeader)) + header->slotStride * (index % header->slots);
+    ShmFrameHeader* frame = (ShmFrameHeader*)slot;
+
+    // seqlock: odd while writing, readers retry or skip the slot
+    volatile uint64_t* sequence = &frame->sequence;
+    *sequence = 2 * index + 1;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    frame->frame = _frame;
+    frame->time = _time;
+    frame->width = _width;
+    frame->height = _height;
+    frame->format = _format;
+    frame->bytes = bytes;
+    memcpy(slot + align(sizeof(ShmFrameHeader)), _pixels, bytes);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    *sequence = 2 * index + 2;
+    std::atomic_thread_fence(std::memory_order_release);
+    *((volatile uint64_t*)&header->published) = index + 1;
+    __atomic_add_fetch(&header->signal, 1, __ATOMIC_RELEASE);
+
+    #if defined(__linux__)
+    // not FUTEX_PRIVATE_FLAG, waiters live in other processes
+    syscall(SYS_futex, &header->signal, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    #endif
+
+    return true;
+}
+
+void ShmSink::close() {
+    if (m_data) {
+        munmap(m_data, m_size);
+        shm_unlink(m_name.c_str());
+        m_data = nullptr;
+    }
+    m_size = 0;
+}
+
+#else
+
+bool ShmSink::open(const std::string& _name, size_t _frameBytes, int _slots) {
+    std::cerr << "Shared memory output is not supported on this platform" << std::endl;
+    return false;
+}
+
+bool ShmSink::publish(const void* _pixels, int _width, int _height, ShmFormat _format, int64_t _frame, double _time) {
+    return false;
+}
+
+void ShmSink::close() {
+}
+
+#endif
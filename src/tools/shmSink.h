@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/** Layout of the shared memory published by ShmSink: a ShmRingHeader followed by a ring of
+ *  slots, each one a ShmFrameHeader and its pixels. Readers map it read-only and follow the
+ *  "published" counter; a slot can be read in place as long as its sequence is the same (and
+ *  even) before and after reading it. On Linux every frame also wakes a futex on "signal".
+ *  Frames bigger than the slots recreate the ring, readers have to map it again **/
+struct ShmRingHeader {
+    char        magic[8];       // "GLSLVIEW"
+    uint32_t    version;
+    uint32_t    slots;
+    uint64_t    slotBytes;      // capacity for pixels of each slot
+    uint64_t    slotStride;     // from one slot header to the next
+    uint64_t    published;      // frames written so far, the last one is on slot (published - 1) % slots
+    uint32_t    signal;
+    uint32_t    reserved;
+};
+
+struct ShmFrameHeader {
+    uint64_t    sequence;       // odd while it's being written
+    int64_t     frame;
+    double      time;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    format;         // SHM_FORMAT_*
+    uint32_t    reserved;
+    uint64_t    bytes;
+};
+
+enum ShmFormat {
+    SHM_FORMAT_RGBA8 = 0        // 8 bits RGBA, rows bottom-up like glReadPixels
+};
+
+/** Publishes frames into a POSIX shared memory ring so other processes can consume
+ *  them at full frame rate without going through files **/
+class ShmSink {
+public:
+    ShmSink();
+    virtual ~ShmSink();
+
+    bool    open(const std::string& _name, size_t _frameBytes, int _slots = 4);
+    bool    publish(const void* _pixels, int _width, int _height, ShmFormat _format, int64_t _frame, double _time);
+    void    close();
+
+    bool    isOpen() const { return m_data != nullptr; }
+    const std::string& getName() const { return m_name; }
+    int     getSlots() const { return m_slots; }
+
+private:
+    std::string     m_name;
+    unsigned char*  m_data;
+    size_t          m_size;
+    size_t          m_slotBytes;
+    int             m_slots;
+};
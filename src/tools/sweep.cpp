@@ -0,0 +1,253 @@
+#include "sweep.h"
+
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "vera/ops/string.h"
+
+ParameterSweep::ParameterSweep() : m_prefix("sweep_"), m_format("png"), m_mode(SWEEP_GRID), m_count(16), m_seed(0), m_current(0), m_running(false) {
+}
+
+ParameterSweep::~ParameterSweep() {
+}
+
+bool ParameterSweep::load(const std::string& _specFile) {
+    std::ifstream in(_specFile.c_str());
+    if (!in.is_open()) {
+        std::cerr << "Can't open the sweep spec " << _specFile << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) {
+        std::cerr << "A sweep is already running" << std::endl;
+        return false;
+    }
+
+    m_parameters.clear();
+    m_prefix = "sweep_";
+    m_format = "png";
+    m_mode = SWEEP_GRID;
+    m_count = 16;
+    m_seed = 0;
+
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line = line.substr(0, comment);
+
+        std::vector<std::string> values = vera::split(line, ',', true);
+        if (values.size() == 0 || values[0].empty())
+            continue;
+
+        if (values[0] == "mode" && values.size() == 2)
+            m_mode = (values[1] == "random")? SWEEP_RANDOM : ((values[1] == "lhs")? SWEEP_LHS : SWEEP_GRID);
+        else if (values[0] == "samples" && values.size() == 2)
+            m_count = std::max(1, vera::toInt(values[1]));
+        else if (values[0] == "seed" && values.size() == 2)
+            m_seed = (unsigned int)vera::toInt(values[1]);
+        else if (values[0] == "output" && values.size() == 2)
+            m_prefix = values[1];
+        else if (values[0] == "format" && values.size() == 2)
+            m_format = values[1];
+        else if (values[0] == "uniform" && values.size() >= 4) {
+            SweepParameter parameter;
+            parameter.name = values[1];
+            parameter.min = vera::toFloat(values[2]);
+            parameter.max = vera::toFloat(values[3]);
+            if (values.size() >= 5)
+                parameter.steps = std::max(1, vera::toInt(values[4]));
+            m_parameters.push_back(parameter);
+        }
+        else if (values[0] == "define" && values.size() >= 3) {
+            SweepParameter parameter;
+            parameter.name = values[1];
+            parameter.define = true;
+            parameter.values.assign(values.begin() + 2, values.end());
+            m_parameters.push_back(parameter);
+        }
+        else
+            std::cerr << _specFile << ":" << number << " can't parse '" << line << "'" << std::endl;
+    }
+
+    if (m_parameters.size() == 0) {
+        std::cerr << "The sweep spec " << _specFile << " has no uniforms nor defines" << std::endl;
+        return false;
+    }
+
+    _generate();
+    return true;
+}
+
+static std::string toValue(float _value) {
+    return vera::toString(_value, 6);
+}
+
+void ParameterSweep::_generate() {
+    m_samples.clear();
+    std::mt19937 rng(m_seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    if (m_mode == SWEEP_GRID) {
+        // odometer over the steps (or values) of each parameter, defines first so they change the least
+        std::vector<size_t> order;
+        for (size_t p = 0; p < m_parameters.size(); p++)
+            if (m_parameters[p].define)
+                order.push_back(p);
+        for (size_t p = 0; p < m_parameters.size(); p++)
+            if (!m_parameters[p].define)
+                order.push_back(p);
+
+        std::vector<int> counts(m_parameters.size());
+        size_t total = 1;
+        for (size_t p = 0; p < m_parameters.size(); p++) {
+            counts[p] = m_parameters[p].define? (int)m_parameters[p].values.size() : m_parameters[p].steps;
+            total *= counts[p];
+        }
+
+        std::vector<int> index(m_parameters.size(), 0);
+        for (size_t s = 0; s < total; s++) {
+            std::vector<std::string> sample(m_parameters.size());
+            for (size_t p = 0; p < m_parameters.size(); p++) {
+                const SweepParameter& parameter = m_parameters[p];
+                if (parameter.define)
+                    sample[p] = parameter.values[index[p]];
+                else {
+                    float t = (parameter.steps > 1)? (float)index[p] / (float)(parameter.steps - 1) : 0.5f;
+                    sample[p] = toValue(parameter.min + t * (parameter.max - parameter.min));
+                }
+            }
+            m_samples.push_back(sample);
+
+            for (int o = (int)order.size() - 1; o >= 0; o--) {
+                size_t p = order[o];
+                if (++index[p] < counts[p])
+                    break;
+                index[p] = 0;
+            }
+        }
+        return;
+    }
+
+    // random and latin hypercube samples, in [0,1) for each parameter
+    std::vector< std::vector<float> > strata(m_parameters.size());
+    for (size_t p = 0; p < m_parameters.size(); p++) {
+        strata[p].resize(m_count);
+        if (m_mode == SWEEP_LHS) {
+            std::vector<int> permutation(m_count);
+            for (int i = 0; i < m_count; i++)
+                permutation[i] = i;
+            std::shuffle(permutation.begin(), permutation.end(), rng);
+            for (int i = 0; i < m_count; i++)
+                strata[p][i] = (permutation[i] + uniform(rng)) / (float)m_count;
+        }
+        else
+            for (int i = 0; i < m_count; i++)
+                strata[p][i] = uniform(rng);
+    }
+
+    for (int i = 0; i < m_count; i++) {
+        std::vector<std::string> sample(m_parameters.size());
+        for (size_t p = 0; p < m_parameters.size(); p++) {
+            const SweepParameter& parameter = m_parameters[p];
+            float t = strata[p][i];
+            if (parameter.define)
+                sample[p] = parameter.values[ std::min((size_t)(t * parameter.values.size()), parameter.values.size() - 1) ];
+            else
+                sample[p] = toValue(parameter.min + t * (parameter.max - parameter.min));
+        }
+        m_samples.push_back(sample);
+    }
+
+    // group the samples by defines, so each combination of them compiles once
+    std::vector<SweepParameter> parameters = m_parameters;
+    std::stable_sort(m_samples.begin(), m_samples.end(), [&parameters](const std::vector<std::string>& _a, const std::vector<std::string>& _b) {
+        for (size_t p = 0; p < parameters.size(); p++)
+            if (parameters[p].define && _a[p] != _b[p])
+                return _a[p] < _b[p];
+        return false;
+    });
+}
+
+void ParameterSweep::start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_current = 0;
+    m_defines.clear();
+    m_running = m_samples.size() > 0;
+}
+
+void ParameterSweep::stop() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+    m_done.notify_all();
+}
+
+bool ParameterSweep::isRunning() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_running;
+}
+
+size_t ParameterSweep::getCurrent() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_current;
+}
+
+bool ParameterSweep::next(std::vector<std::string>& _values, std::string& _file) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running || m_current >= m_samples.size())
+        return false;
+
+    size_t index = m_current++;
+    _values = m_samples[index];
+
+    std::string name = m_prefix + vera::toString((int)index, 0, 5, '0');
+    _file = name + "." + m_format;
+
+    // sidecar with what this frame was rendered with
+    std::ofstream json((name + ".json").c_str());
+    json << "{\n    \"index\": " << index << ",\n    \"file\": \"" << _file << "\",\n";
+    json << "    \"mode\": \"" << ((m_mode == SWEEP_GRID)? "grid" : ((m_mode == SWEEP_RANDOM)? "random" : "lhs")) << "\",\n";
+    json << "    \"seed\": " << m_seed << ",\n";
+    for (int define = 0; define < 2; define++) {
+        json << "    \"" << (define? "defines" : "uniforms") << "\": {";
+        bool first = true;
+        for (size_t p = 0; p < m_parameters.size(); p++) {
+            if (m_parameters[p].define != (define == 1))
+                continue;
+            json << (first? " " : ", ") << "\"" << m_parameters[p].name << "\": ";
+            if (define)
+                json << "\"" << _values[p] << "\"";
+            else
+                json << _values[p];
+            first = false;
+        }
+        json << (first? "}" : " }") << (define? "\n" : ",\n");
+    }
+    json << "}\n";
+    return true;
+}
+
+bool ParameterSweep::updateDefine(const std::string& _name, const std::string& _value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<std::string, std::string>::iterator it = m_defines.find(_name);
+    if (it != m_defines.end() && it->second == _value)
+        return false;
+    m_defines[_name] = _value;
+    return true;
+}
+
+void ParameterSweep::finish() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+    m_done.notify_all();
+}
+
+void ParameterSweep::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]{ return !m_running; });
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <condition_variable>
+
+enum SweepMode {
+    SWEEP_GRID = 0,     // every combination of the steps of each parameter
+    SWEEP_RANDOM,       // independent uniform samples
+    SWEEP_LHS           // latin hypercube: each parameter covers all its strata exactly once
+};
+
+struct SweepParameter {
+    std::string                 name;
+    bool                        define  = false;
+    float                       min     = 0.0f;     // uniforms
+    float                       max     = 1.0f;
+    int                         steps   = 5;        // for grids
+    std::vector<std::string>    values;             // defines
+};
+
+/** Renders many variations of the same shader in one process. A spec file lists the
+ *  uniforms (ranges) and defines (values) to sweep, one per line:
+ *
+ *      mode,grid|random|lhs
+ *      samples,<count>                     (random and lhs)
+ *      seed,<number>
+ *      output,<prefix>                     (frames are <prefix><index>.<format>)
+ *      format,png|tga|hdr|exr
+ *      uniform,<name>,<min>,<max>[,<steps>]
+ *      define,<NAME>,<value>[,<value>...]
+ *
+ *  Samples are sorted by their defines, so shaders only recompile when those change.
+ *  Every frame gets a <prefix><index>.json with the values it was rendered with. The
+ *  viewer holds u_time still while a sweep runs, so time doesn't vary between samples **/
+class ParameterSweep {
+public:
+    ParameterSweep();
+    virtual ~ParameterSweep();
+
+    bool    load(const std::string& _specFile);
+    void    start();
+    void    stop();
+
+    bool    isRunning() const;
+    size_t  getTotal() const { return m_samples.size(); }
+    size_t  getCurrent() const;
+
+    const std::vector<SweepParameter>& getParameters() const { return m_parameters; }
+
+    // Next sample to render, with one value per parameter, and the file it goes to.
+    // Writes its metadata next to it. False once all of them were handed out
+    bool    next(std::vector<std::string>& _values, std::string& _file);
+
+    // True if _value isn't what this sweep last set the define _name to, and keeps it as such
+    bool    updateDefine(const std::string& _name, const std::string& _value);
+
+    // Called once the last frame is taken, wakes up whoever waits for the sweep
+    void    finish();
+
+    // Blocks until the sweep finishes or is stopped
+    void    wait();
+
+private:
+    void    _generate();
+
+    std::vector<SweepParameter>             m_parameters;
+    std::vector< std::vector<std::string> > m_samples;
+    std::map<std::string, std::string>      m_defines;  // set since the sweep started
+    std::string                             m_prefix;
+    std::string                             m_format;
+    SweepMode                               m_mode;
+    int                                     m_count;
+    unsigned int                            m_seed;
+
+    mutable std::mutex                      m_mutex;
+    std::condition_variable                 m_done;
+    size_t                                  m_current;
+    bool                                    m_running;
+};
@@ -0,0 +1,48 @@
+#include "textureUnits.h"
+
+// Marks a unit (or the active one) as unknown
+#define UNKNOWN_UNIT -1
+#define UNKNOWN_TEXTURE 0xFFFFFFFF
+
+TextureUnits::TextureUnits() : m_active(UNKNOWN_UNIT), m_batch(false) {
+    invalidate();
+}
+
+void TextureUnits::begin() {
+    invalidate();
+    m_batch = true;
+}
+
+void TextureUnits::end() {
+    m_batch = false;
+    invalidate();
+}
+
+void TextureUnits::invalidate() {
+    invalidate(0, TEXTURE_UNITS_TRACKED);
+}
+
+void TextureUnits::invalidate(int _from, int _to) {
+    for (int i = (_from < 0)? 0 : _from; i < _to && i < TEXTURE_UNITS_TRACKED; i++) {
+        m_bound[i] = UNKNOWN_TEXTURE;
+        m_targets[i] = 0;
+    }
+    m_active = UNKNOWN_UNIT;
+}
+
+void TextureUnits::bind(int _unit, GLenum _target, GLuint _id) {
+    bool tracked = m_batch && _unit >= 0 && _unit < TEXTURE_UNITS_TRACKED;
+    if (tracked && m_bound[_unit] == _id && m_targets[_unit] == _target)
+        return;
+
+    if (!tracked || m_active != _unit) {
+        glActiveTexture(GL_TEXTURE0 + _unit);
+        m_active = tracked? _unit : UNKNOWN_UNIT;
+    }
+    glBindTexture(_target, _id);
+
+    if (tracked) {
+        m_bound[_unit] = _id;
+        m_targets[_unit] = _target;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "vera/gl/gl.h"
+
+// Units tracked, binds to higher ones always go through
+#define TEXTURE_UNITS_TRACKED 32
+
+/** Mirror of the texture bound to each unit, so passes that keep binding the same
+ *  textures (buffers reading each other every frame) skip the redundant glActiveTexture
+ *  and glBindTexture calls. The mirror only holds inside a begin()/end() batch where
+ *  every bind goes through it: code that binds textures on its own (vera, models, UI)
+ *  has to run outside of it or invalidate() the units it touched **/
+class TextureUnits {
+public:
+    TextureUnits();
+
+    void    begin();
+    void    end();
+    bool    isBatching() const { return m_batch; }
+
+    void    invalidate();
+    void    invalidate(int _from, int _to);
+
+    void    bind(int _unit, GLenum _target, GLuint _id);
+
+private:
+    GLuint  m_bound[TEXTURE_UNITS_TRACKED];
+    GLenum  m_targets[TEXTURE_UNITS_TRACKED];
+    int     m_active;
+    bool    m_batch;
+};
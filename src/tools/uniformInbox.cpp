@@ -0,0 +1,210 @@
+#include "uniformInbox.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <iostream>
+
+double uniformClock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum {
+    SLOT_EMPTY = 0,
+    SLOT_NAMING,    // a producer is writing its name
+    SLOT_READY
+};
+
+UniformInbox::UniformInbox(size_t _capacity, size_t _slots) : m_enqueue(0), m_dequeue(0), m_dropped(0), m_slotsCount(_slots), m_latest(0) {
+    // power of two, so positions wrap with a mask
+    size_t capacity = 2;
+    while (capacity < _capacity)
+        capacity *= 2;
+
+    m_cells.reset(new Cell[capacity]);
+    m_mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+
+    m_slots.reset(new Slot[m_slotsCount]);
+    for (size_t i = 0; i < m_slotsCount; i++) {
+        Slot& slot = m_slots[i];
+        slot.state.store(SLOT_EMPTY, std::memory_order_relaxed);
+        slot.name[0] = 0;
+        slot.coalesce.store(true, std::memory_order_relaxed);
+        slot.pending.store(false, std::memory_order_relaxed);
+        slot.sequence.store(0, std::memory_order_relaxed);
+        for (size_t j = 0; j < 4; j++)
+            slot.value[j].store(0.0f, std::memory_order_relaxed);
+        slot.size.store(0, std::memory_order_relaxed);
+        slot.bInt.store(false, std::memory_order_relaxed);
+        slot.timestamp.store(0.0, std::memory_order_relaxed);
+    }
+}
+
+// Open addressing over the slots, names are only ever added
+bool UniformInbox::_find(const std::string& _name, size_t& _slot) {
+    if (_name.size() >= UNIFORM_INBOX_NAME) {
+        std::cerr << "Uniform name " << _name << " is longer than " << (UNIFORM_INBOX_NAME - 1) << " characters" << std::endl;
+        return false;
+    }
+
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < _name.size(); i++)
+        hash = (hash ^ (unsigned char)_name[i]) * 16777619u;
+
+    for (size_t i = 0; i < m_slotsCount; ) {
+        size_t index = (hash + i) % m_slotsCount;
+        Slot& slot = m_slots[index];
+        int state = slot.state.load(std::memory_order_acquire);
+
+        if (state == SLOT_EMPTY) {
+            if (slot.state.compare_exchange_strong(state, SLOT_NAMING, std::memory_order_acquire)) {
+                memcpy(slot.name, _name.c_str(), _name.size() + 1);
+                slot.state.store(SLOT_READY, std::memory_order_release);
+                _slot = index;
+                return true;
+            }
+            // someone else took it, see what for
+            continue;
+        }
+
+        if (state == SLOT_NAMING) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (strcmp(slot.name, _name.c_str()) == 0) {
+            _slot = index;
+            return true;
+        }
+        i++;
+    }
+
+    std::cerr << "No room for the uniform " << _name << ", there are already " << m_slotsCount << std::endl;
+    return false;
+}
+
+bool UniformInbox::push(const std::string& _name, const float* _value, size_t _size, bool _int) {
+    size_t index;
+    if (!_find(_name, index))
+        return false;
+
+    UniformSample sample;
+    sample.slot = index;
+    sample.size = (_size > 4)? 4 : _size;
+    for (size_t i = 0; i < 4; i++)
+        sample.value[i] = (i < sample.size)? _value[i] : 0.0f;
+    sample.bInt = _int;
+    sample.timestamp = uniformClock();
+
+    Slot& slot = m_slots[index];
+    if (slot.coalesce.load(std::memory_order_acquire)) {
+        // take the slot from other producers (odd sequence) while writing it
+        unsigned sequence = slot.sequence.load(std::memory_order_relaxed);
+        while ((sequence & 1) || !slot.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire))
+            sequence = slot.sequence.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < 4; i++)
+            slot.value[i].store(sample.value[i], std::memory_order_relaxed);
+        slot.size.store(sample.size, std::memory_order_relaxed);
+        slot.bInt.store(sample.bInt, std::memory_order_relaxed);
+        slot.timestamp.store(sample.timestamp, std::memory_order_relaxed);
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+
+        if (!slot.pending.exchange(true, std::memory_order_acq_rel))
+            m_latest++;
+        return true;
+    }
+
+    // full, make room dropping the oldest value
+    while (!_enqueue(sample)) {
+        UniformSample oldest;
+        if (pop(oldest))
+            m_dropped++;
+    }
+    return true;
+}
+
+bool UniformInbox::setCoalesce(const std::string& _name, bool _coalesce) {
+    size_t index;
+    if (!_find(_name, index))
+        return false;
+    m_slots[index].coalesce.store(_coalesce, std::memory_order_release);
+    return true;
+}
+
+bool UniformInbox::popLatest(size_t& _slot, UniformSample& _sample) {
+    for (; _slot < m_slotsCount && m_latest.load(std::memory_order_acquire) > 0; _slot++) {
+        Slot& slot = m_slots[_slot];
+        if (!slot.pending.load(std::memory_order_relaxed) || !slot.pending.exchange(false, std::memory_order_acq_rel))
+            continue;
+        m_latest--;
+
+        // read until no producer wrote it in the meantime
+        unsigned before, after;
+        do {
+            before = slot.sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < 4; i++)
+                _sample.value[i] = slot.value[i].load(std::memory_order_relaxed);
+            _sample.size = slot.size.load(std::memory_order_relaxed);
+            _sample.bInt = slot.bInt.load(std::memory_order_relaxed);
+            _sample.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = slot.sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        _sample.slot = _slot++;
+        return true;
+    }
+    return false;
+}
+
+bool UniformInbox::_enqueue(const UniformSample& _sample) {
+    Cell* cell;
+    size_t pos = m_enqueue.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &m_cells[pos & m_mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t dif = (std::ptrdiff_t)sequence - (std::ptrdiff_t)pos;
+        if (dif == 0) {
+            if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+            return false;
+        else
+            pos = m_enqueue.load(std::memory_order_relaxed);
+    }
+
+    cell->sample = _sample;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool UniformInbox::pop(UniformSample& _sample) {
+    Cell* cell;
+    size_t pos = m_dequeue.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &m_cells[pos & m_mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t dif = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(pos + 1);
+        if (dif == 0) {
+            if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+            return false;
+        else
+            pos = m_dequeue.load(std::memory_order_relaxed);
+    }
+
+    _sample = cell->sample;
+    cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return true;
+}
+
+bool UniformInbox::empty() const {
+    return m_latest.load(std::memory_order_acquire) <= 0 && m_dequeue.load(std::memory_order_acquire) >= m_enqueue.load(std::memory_order_acquire);
+}
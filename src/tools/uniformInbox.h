@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstddef>
+
+// Longest uniform name the inbox carries (the terminating zero included)
+#define UNIFORM_INBOX_NAME 64
+
+// Seconds on a steady clock, to timestamp the values as they arrive
+double uniformClock();
+
+struct UniformSample {
+    size_t      slot        = 0;    // of the uniform in the inbox, see UniformInbox::getName()
+    float       value[4];
+    size_t      size        = 0;
+    bool        bInt        = false;
+    double      timestamp   = 0.0;
+};
+
+/** Carries uniform values from the console and OSC threads to the render thread, which
+ *  drains it once per frame. Every uniform gets a slot the first time its name is seen.
+ *  Uniforms where only the latest value counts are coalesced into their slot, so a burst
+ *  of them takes no room and the newest one always wins. The rest go, in order, through a
+ *  bounded multi-producer/multi-consumer ring (after Dmitry Vyukov's) that drops the oldest
+ *  values when the render thread falls behind. Pushing never blocks nor allocates **/
+class UniformInbox {
+public:
+    UniformInbox(size_t _capacity = 1024, size_t _slots = 256);
+
+    // Any thread. False if the name doesn't fit or there are no slots left
+    bool    push(const std::string& _name, const float* _value, size_t _size, bool _int);
+
+    // Any thread. Values of _name are coalesced (the default) or queued in order
+    bool    setCoalesce(const std::string& _name, bool _coalesce);
+
+    // Values queued in order. Any thread, but they are only in order with a single consumer
+    bool    pop(UniformSample& _sample);
+
+    // Render thread. The latest value of the next coalesced slot that changed, from _slot on.
+    // Returns false once there are no more
+    bool    popLatest(size_t& _slot, UniformSample& _sample);
+
+    const char* getName(size_t _slot) const { return m_slots[_slot].name; }
+
+    bool    empty() const;
+    size_t  getCapacity() const { return m_mask + 1; }
+    size_t  getDropped() const { return m_dropped.load(); }
+
+private:
+    struct Cell {
+        std::atomic<size_t>     sequence;
+        UniformSample           sample;
+    };
+
+    // Written under a sequence lock, every field is atomic so readers never race writers
+    struct Slot {
+        std::atomic<int>        state;      // SLOT_EMPTY, SLOT_NAMING or SLOT_READY
+        char                    name[UNIFORM_INBOX_NAME];
+        std::atomic<bool>       coalesce;
+        std::atomic<bool>       pending;
+        std::atomic<unsigned>   sequence;   // odd while a producer writes the value
+        std::atomic<float>      value[4];
+        std::atomic<size_t>     size;
+        std::atomic<bool>       bInt;
+        std::atomic<double>     timestamp;
+    };
+
+    bool    _find(const std::string& _name, size_t& _slot);
+    bool    _enqueue(const UniformSample& _sample);
+
+    std::unique_ptr<Cell[]>     m_cells;
+    size_t                      m_mask;
+    std::atomic<size_t>         m_enqueue;
+    std::atomic<size_t>         m_dequeue;
+    std::atomic<size_t>         m_dropped;
+
+    std::unique_ptr<Slot[]>     m_slots;
+    size_t                      m_slotsCount;
+    std::atomic<int>            m_latest;   // coalesced values waiting
+};
@@ -0,0 +1,301 @@
+#include "videoEncoder.h"
+
+#include <cmath>
+#include <iostream>
+
+#if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+// Describes a libav error code
+static std::string avError(int _code) {
+    char msg[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+    av_strerror(_code, msg, sizeof(msg));
+    return std::string(msg);
+}
+
+VideoEncoder::VideoEncoder() :
+    m_format(nullptr), m_codec(nullptr), m_stream(nullptr), m_frame(nullptr), m_input(nullptr), m_packet(nullptr), m_sws(nullptr),
+    m_srcWidth(0), m_srcHeight(0), m_srcFormat(VIDEO_RGB), m_fpsRatio(1.0), m_count(0), m_pts(0), m_header(false) {
+}
+
+VideoEncoder::~VideoEncoder() {
+    close();
+}
+
+bool VideoEncoder::open(const std::string& _path, int _srcWidth, int _srcHeight, VideoPixelFormat _srcFormat, float _srcFps, 
+                        int _trgWidth, int _trgHeight, float _trgFps, const VideoCodecSettings& _settings) {
+    close();
+
+    m_srcWidth = _srcWidth;
+    m_srcHeight = _srcHeight;
+    m_srcFormat = _srcFormat;
+    m_fpsRatio = (_srcFps > 0.0f)? _trgFps / _srcFps : 1.0;
+    m_count = 0;
+    m_pts = 0;
+
+    int ret = avformat_alloc_output_context2(&m_format, nullptr, nullptr, _path.c_str());
+    if (ret < 0 || !m_format) {
+        std::cerr << "Can't find a container format for " << _path << ": " << avError(ret) << std::endl;
+        m_format = nullptr;
+        return false;
+    }
+
+    // the codec asked for, otherwise whatever the container defaults to
+    const AVCodec* codec = nullptr;
+    if (!_settings.codec.empty())
+        codec = avcodec_find_encoder_by_name(_settings.codec.c_str());
+    if (!codec)
+        codec = avcodec_find_encoder(m_format->oformat->video_codec);
+    if (!codec) {
+        std::cerr << "Can't find a video encoder for " << _path << std::endl;
+        close();
+        return false;
+    }
+
+    m_stream = avformat_new_stream(m_format, nullptr);
+    m_codec = avcodec_alloc_context3(codec);
+    m_frame = av_frame_alloc();
+    m_packet = av_packet_alloc();
+    if (!m_stream || !m_codec || !m_frame || !m_packet) {
+        std::cerr << "Can't allocate the video encoder" << std::endl;
+        close();
+        return false;
+    }
+
+    m_codec->width = _trgWidth;
+    m_codec->height = _trgHeight;
+    m_codec->time_base = av_d2q(1.0 / _trgFps, 1000000);
+    m_codec->framerate = av_d2q(_trgFps, 1000000);
+    m_codec->pix_fmt = AV_PIX_FMT_YUV420P;
+    m_codec->bit_rate = _settings.bitrate;
+    m_codec->gop_size = _settings.gop;
+    if (m_format->oformat->flags & AVFMT_GLOBALHEADER)
+        m_codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if (codec->id == AV_CODEC_ID_H264 || codec->id == AV_CODEC_ID_HEVC) {
+        if (_settings.crf >= 0 && (ret = av_opt_set_int(m_codec->priv_data, "crf", _settings.crf, 0)) < 0)
+            std::cerr << "Can't set the crf of " << codec->name << ": " << avError(ret) << std::endl;
+        if (!_settings.preset.empty() && (ret = av_opt_set(m_codec->priv_data, "preset", _settings.preset.c_str(), 0)) < 0)
+            std::cerr << "Can't set the preset of " << codec->name << ": " << avError(ret) << std::endl;
+    }
+
+    if ((ret = avcodec_open2(m_codec, codec, nullptr)) < 0) {
+        std::cerr << "Can't open the video encoder " << codec->name << ": " << avError(ret) << std::endl;
+        close();
+        return false;
+    }
+
+    if ((ret = avcodec_parameters_from_context(m_stream->codecpar, m_codec)) < 0) {
+        std::cerr << "Can't set the stream parameters of " << _path << ": " << avError(ret) << std::endl;
+        close();
+        return false;
+    }
+    m_stream->time_base = m_codec->time_base;
+
+    if ( !(m_format->oformat->flags & AVFMT_NOFILE) )
+        if ((ret = avio_open(&m_format->pb, _path.c_str(), AVIO_FLAG_WRITE)) < 0) {
+            std::cerr << "Can't open " << _path << " for writing: " << avError(ret) << std::endl;
+            close();
+            return false;
+        }
+
+    if ((ret = avformat_write_header(m_format, nullptr)) < 0) {
+        std::cerr << "Can't write the header of " << _path << ": " << avError(ret) << std::endl;
+        close();
+        return false;
+    }
+    m_header = true;
+
+    m_frame->format = m_codec->pix_fmt;
+    m_frame->width = m_codec->width;
+    m_frame->height = m_codec->height;
+    if ((ret = av_frame_get_buffer(m_frame, 0)) < 0) {
+        std::cerr << "Can't allocate the video frame: " << avError(ret) << std::endl;
+        close();
+        return false;
+    }
+
+    bool scaling = (_srcWidth != _trgWidth || _srcHeight != _trgHeight);
+    if (_srcFormat == VIDEO_YUV420 && !scaling) {
+        m_input = av_frame_alloc();
+        if (!m_input) {
+            std::cerr << "Can't allocate the video frame" << std::endl;
+            close();
+            return false;
+        }
+        m_input->format = m_codec->pix_fmt;
+        m_input->width = m_codec->width;
+        m_input->height = m_codec->height;
+    }
+    else {
+        AVPixelFormat srcFormat = AV_PIX_FMT_RGB24;
+        if (_srcFormat == VIDEO_RGBA)
+            srcFormat = AV_PIX_FMT_RGBA;
+        else if (_srcFormat == VIDEO_YUV420)
+            srcFormat = AV_PIX_FMT_YUV420P;
+
+        // same lanczos scaling the ffmpeg pipe uses
+        m_sws = sws_getContext( _srcWidth, _srcHeight, srcFormat,
+                                _trgWidth, _trgHeight, m_codec->pix_fmt,
+                                scaling? SWS_LANCZOS : SWS_POINT, nullptr, nullptr, nullptr);
+        if (!m_sws) {
+            std::cerr << "Can't convert " << _srcWidth << "x" << _srcHeight << " frames to " << _trgWidth << "x" << _trgHeight << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool VideoEncoder::encode(const unsigned char* _pixels) {
+    if (!m_format || !m_frame)
+        return false;
+
+    uint8_t* src[4] = { nullptr, nullptr, nullptr, nullptr };
+    int srcStride[4] = { 0, 0, 0, 0 };
+
+    if (m_srcFormat == VIDEO_YUV420) {
+        int ret = av_image_fill_arrays(src, srcStride, _pixels, AV_PIX_FMT_YUV420P, m_srcWidth, m_srcHeight, 1);
+        if (ret < 0) {
+            std::cerr << "Can't read the YUV420 frame: " << avError(ret) << std::endl;
+            return false;
+        }
+
+        // already in the codec format, the codec copies what it needs to keep
+        if (m_input) {
+            for (int i = 0; i < 4; i++) {
+                m_input->data[i] = src[i];
+                m_input->linesize[i] = srcStride[i];
+            }
+            return _send(m_input);
+        }
+    }
+    else {
+        // glReadPixels rows go bottom-up, read them backwards to flip the image
+        int stride = m_srcWidth * ((m_srcFormat == VIDEO_RGBA)? 4 : 3);
+        src[0] = const_cast<uint8_t*>(_pixels) + (size_t)(m_srcHeight - 1) * stride;
+        srcStride[0] = -stride;
+    }
+
+    int ret = av_frame_make_writable(m_frame);
+    if (ret < 0) {
+        std::cerr << "Can't write into the video frame: " << avError(ret) << std::endl;
+        return false;
+    }
+
+    sws_scale(m_sws, src, srcStride, 0, m_srcHeight, m_frame->data, m_frame->linesize);
+    return _send(m_frame);
+}
+
+// Encode the frame as many times as target frames fall inside its source frame (none, once or more)
+bool VideoEncoder::_send(AVFrame* _frame) {
+    long long end = (long long)std::ceil(++m_count * m_fpsRatio - 1e-6);
+    while (m_pts < end) {
+        _frame->pts = m_pts++;
+        if (!_write(_frame))
+            return false;
+    }
+    return true;
+}
+
+bool VideoEncoder::_write(AVFrame* _frame) {
+    int ret = avcodec_send_frame(m_codec, _frame);
+    if (ret < 0) {
+        std::cerr << "Error sending a frame to the video encoder: " << avError(ret) << std::endl;
+        return false;
+    }
+
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(m_codec, m_packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return true;
+        else if (ret < 0) {
+            std::cerr << "Error encoding a video frame: " << avError(ret) << std::endl;
+            return false;
+        }
+
+        av_packet_rescale_ts(m_packet, m_codec->time_base, m_stream->time_base);
+        m_packet->stream_index = m_stream->index;
+
+        // takes ownership of the packet data, even on errors (a full disk, a muxer error, ...)
+        ret = av_interleaved_write_frame(m_format, m_packet);
+        if (ret < 0) {
+            std::cerr << "Error writing a video frame: " << avError(ret) << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool VideoEncoder::close() {
+    if (!m_format)
+        return false;
+
+    bool ok = true;
+    if (m_header) {
+        // flush the frames still inside the encoder
+        ok = _write(nullptr);
+
+        int ret = av_write_trailer(m_format);
+        if (ret < 0) {
+            std::cerr << "Error writing the trailer of the video: " << avError(ret) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (m_sws)
+        sws_freeContext(m_sws);
+    if (m_packet)
+        av_packet_free(&m_packet);
+    if (m_frame)
+        av_frame_free(&m_frame);
+    if (m_input)
+        av_frame_free(&m_input);
+    if (m_codec)
+        avcodec_free_context(&m_codec);
+    if ( !(m_format->oformat->flags & AVFMT_NOFILE) && m_format->pb ) {
+        int ret = avio_closep(&m_format->pb);
+        if (ret < 0) {
+            std::cerr << "Error closing the video file: " << avError(ret) << std::endl;
+            ok = false;
+        }
+    }
+    avformat_free_context(m_format);
+
+    m_format = nullptr;
+    m_stream = nullptr;
+    m_sws = nullptr;
+    m_header = false;
+
+    return ok;
+}
+
+#else
+
+VideoEncoder::VideoEncoder() :
+    m_format(nullptr), m_codec(nullptr), m_stream(nullptr), m_frame(nullptr), m_input(nullptr), m_packet(nullptr), m_sws(nullptr),
+    m_srcWidth(0), m_srcHeight(0), m_srcFormat(VIDEO_RGB), m_fpsRatio(1.0), m_count(0), m_pts(0), m_header(false) {
+}
+
+VideoEncoder::~VideoEncoder() {}
+
+bool VideoEncoder::open(const std::string&, int, int, VideoPixelFormat, float, int, int, float, const VideoCodecSettings&) {
+    std::cerr << "This version of GlslViewer wasn't compiled with LIBAV support" << std::endl;
+    return false;
+}
+
+bool VideoEncoder::encode(const unsigned char*) { return false; }
+bool VideoEncoder::_send(AVFrame*) { return false; }
+bool VideoEncoder::_write(AVFrame*) { return false; }
+bool VideoEncoder::close() { return false; }
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVStream;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+enum VideoPixelFormat {
+    VIDEO_RGB = 0,      // glReadPixels rows (bottom-up)
+    VIDEO_RGBA,         // glReadPixels rows (bottom-up)
+    VIDEO_YUV420        // planar, top-down (see yuv420.h)
+};
+
+/** Codec settings, the same ones the ffmpeg pipe passes as arguments (see record in main.cpp) **/
+struct VideoCodecSettings {
+    std::string codec       = "libx264";    // -c:v
+    long long   bitrate     = 20000000;     // -b:v, in bits per second
+    int         crf         = 18;           // -crf (x264/x265 only, -1 to use the bitrate)
+    int         gop         = 1;            // -g
+    std::string preset      = "";           // -preset (x264/x265 only, empty for the codec default)
+};
+
+/** In-process video encoder built on top of libavcodec/libavformat. RGB frames are
+ *  passed as they come from glReadPixels (bottom-up rows), the vertical flip and
+ *  the pixel format conversion happen while scaling into the encoder frame, so the
+ *  source buffer is never copied. YUV420 frames of the target size go straight
+ *  to the codec. Like ffmpeg's fps filter, frames coming at the source fps are
+ *  dropped or repeated to encode them at the target fps **/
+class VideoEncoder {
+public:
+    VideoEncoder();
+    virtual ~VideoEncoder();
+
+    bool    open(const std::string& _path, int _srcWidth, int _srcHeight, VideoPixelFormat _srcFormat, float _srcFps, 
+                 int _trgWidth, int _trgHeight, float _trgFps, const VideoCodecSettings& _settings);
+    bool    encode(const unsigned char* _pixels);
+    bool    close();
+
+    bool    isOpen() const { return m_format != nullptr; }
+
+private:
+    bool    _send(AVFrame* _frame);
+    bool    _write(AVFrame* _frame);
+
+    AVFormatContext*    m_format;
+    AVCodecContext*     m_codec;
+    AVStream*           m_stream;
+    AVFrame*            m_frame;
+    AVFrame*            m_input;    // wraps the caller's YUV420 planes
+    AVPacket*           m_packet;
+    SwsContext*         m_sws;
+
+    int                 m_srcWidth;
+    int                 m_srcHeight;
+    VideoPixelFormat    m_srcFormat;
+    double              m_fpsRatio; // target / source fps
+    long long           m_count;    // source frames received
+    long long           m_pts;      // target frames encoded
+    bool                m_header;   // the trailer has to be written on close
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+
+/** Planar YUV420 frames (a W*H luma plane followed by two W/2*H/2 chroma planes, top row first)
+ *  rendered on the GPU into an RGBA target of W/2 texels wide, so each target row holds two
+ *  luma rows or four chroma rows. Reading that target back gives the planes ready to encode.
+ *  Width and height have to be even **/
+
+inline void getYUV420PackedSize(int _width, int _height, int& _packedWidth, int& _packedHeight) {
+    _packedWidth = _width / 2;
+    _packedHeight = _height / 2 + (_height + 3) / 4;
+}
+
+inline size_t getYUV420PackedBytes(int _width, int _height) {
+    int w, h;
+    getYUV420PackedSize(_width, _height, w, h);
+    return (size_t)w * (size_t)h * 4;
+}
+
+inline size_t getYUV420Bytes(int _width, int _height) {
+    return (size_t)_width * (size_t)_height * 3 / 2;
+}
+
+const std::string yuv420_frag = R"(
+#ifdef GL_ES
+precision highp float;
+#endif
+
+uniform sampler2D   u_tex0;
+uniform vec2        u_resolution;
+
+// BT.601 limited range, same as swscale's default
+vec3 rgb2yuv(vec3 c) {
+    return vec3( 0.0627 + dot(c, vec3( 0.2568, 0.5041, 0.0979)),
+                 0.5020 + dot(c, vec3(-0.1482,-0.2910, 0.4392)),
+                 0.5020 + dot(c, vec3( 0.4392,-0.3678,-0.0714)) );
+}
+
+// pixels are addressed top-down, the flip happens here
+vec3 pixel(vec2 px) {
+    vec2 uv = vec2(px.x + 0.5, u_resolution.y - px.y - 0.5) / u_resolution;
+    return texture2D(u_tex0, uv).rgb;
+}
+
+vec2 chroma(vec2 px) {
+    vec2 p = px * 2.0;
+    vec3 c = pixel(p) + pixel(p + vec2(1.0, 0.0)) + pixel(p + vec2(0.0, 1.0)) + pixel(p + vec2(1.0, 1.0));
+    return rgb2yuv(c * 0.25).yz;
+}
+
+void main() {
+    vec2 st = floor(gl_FragCoord.xy);
+    float width = u_resolution.x;
+    float halfWidth = u_resolution.x * 0.5;
+    float halfHeight = u_resolution.y * 0.5;
+
+    vec4 color = vec4(0.0);
+    for (int i = 0; i < 4; i++) {
+        float b = st.x * 4.0 + float(i);
+        float v = 0.0;
+
+        if (st.y < halfHeight) {
+            float row = st.y * 2.0 + floor(b / width);
+            v = rgb2yuv( pixel(vec2(mod(b, width), row)) ).x;
+        }
+        else {
+            float row = (st.y - halfHeight) * 4.0 + floor(b / halfWidth);
+            vec2 px = vec2(mod(b, halfWidth), mod(row, halfHeight));
+            if (row < halfHeight)
+                v = chroma(px).x;
+            else if (row < u_resolution.y)
+                v = chroma(px).y;
+        }
+
+        color[i] = v;
+    }
+
+    gl_FragColor = color;
+}
+)";
@@ -20,32 +20,49 @@ std::string UniformData::getType() {
 void UniformData::set(const UniformValue &_value, size_t _size, bool _int ) {
     bInt = _int;
     size = _size;
-
-    if (change)
-        queue.push( _value );
-    else
-        value = _value;
-    
+    value = _value;
+    timestamp = uniformClock();
     change = true;
 }
 
-void UniformData::parse(const std::vector<std::string>& _command, size_t _start) {;
-    UniformValue candidate;
-    for (size_t i = _start; i < _command.size() && i < 5; i++)
-        candidate[i-_start] = vera::toFloat(_command[i]);
+void UniformData::ingest(const UniformSample &_sample) {
+    UniformValue candidate = {{ _sample.value[0], _sample.value[1], _sample.value[2], _sample.value[3] }};
+    bInt = _sample.bInt;
+    size = _sample.size;
+    received++;
+
+    if (policy == UNIFORM_AVERAGE) {
+        for (size_t i = 0; i < 4; i++)
+            sum[i] = ((count == 0)? 0.0f : sum[i]) + candidate[i];
+        count++;
+        timestamp = _sample.timestamp;
+    }
+    else if (policy == UNIFORM_QUEUE) {
+        if (queue.size() >= bound && bound > 0) {
+            queue.pop();
+            dropped++;
+        }
+        UniformQueued queued = { candidate, _sample.timestamp };
+        queue.push(queued);
+    }
+    else {
+        // whatever arrived before it never reaches a frame, by design
+        value = candidate;
+        timestamp = _sample.timestamp;
+        change = true;
+    }
+}
 
-    set(candidate, _command.size() - _start, true);
+void UniformData::discard() {
+    queue = std::queue<UniformQueued>();
+    count = 0;
 }
 
 bool UniformData::check() {
-    if (queue.empty())
-        change = false;
-    else {
-        value = queue.front();
-        queue.pop();
-        change = true;
-    }
-    return change;
+    change = false;
+
+    // still values waiting for the next frames
+    return !queue.empty();
 }
 
 UniformFunction::UniformFunction() {
@@ -68,7 +85,7 @@ UniformFunction::UniformFunction(const std::string &_type, std::function<void(ve
 }
 
 
-Uniforms::Uniforms() : m_change(false) {
+Uniforms::Uniforms() : m_policiesChange(false), m_change(false) {
 
     // IBL
     //
@@ -220,18 +237,168 @@ void Uniforms::clear() {
     vera::Scene::clear();
 }
 
+static GLint getLocation(GLuint _program, const std::string& _name) {
+    return (_program != 0)? glGetUniformLocation(_program, _name.c_str()) : -1;
+}
+
+bool Uniforms::_dispatchValid(const UniformDispatch& _dispatch, GLuint _program) const {
+    // Programs get relinked (or replaced) when their sources or defines change, new native
+    // functions can be registered at any time and textures, streams, buffers or lights
+    // come and go. All of them invalidate the table
+    if (_program == 0 || _dispatch.program != _program || _dispatch.functions != functions.size() ||
+        _dispatch.buffers.size() != buffers.size() ||
+        _dispatch.doubleBuffers.size() != doubleBuffers.size() ||
+        _dispatch.pyramids.size() != pyramids.size() ||
+        _dispatch.textures.size() != textures.size() ||
+        _dispatch.streams.size() != streams.size() ||
+        _dispatch.lights.size() != lights.size() )
+        return false;
+
+    size_t i = 0;
+    for (vera::TexturesMap::const_iterator it = textures.begin(); it != textures.end(); ++it, i++)
+        if (_dispatch.textures[i].name != it->first)
+            return false;
+
+    i = 0;
+    for (vera::TextureStreamsMap::const_iterator it = streams.begin(); it != streams.end(); ++it, i++)
+        if (_dispatch.streams[i].name != it->first || _dispatch.streams[i].locations.size() != SLOT_PREV + it->second->getPrevTexturesTotal())
+            return false;
+
+    i = 0;
+    for (vera::LightsMap::const_iterator it = lights.begin(); it != lights.end(); ++it, i++)
+        if (_dispatch.lights[i].name != it->first)
+            return false;
+
+    return true;
+}
+
+UniformDispatch& Uniforms::_dispatch(vera::Shader *_shader) {
+    UniformDispatch& dispatch = m_dispatch[_shader];
+
+    GLuint program = _shader->getProgram();
+    if (_dispatchValid(dispatch, program))
+        return dispatch;
+
+    dispatch = UniformDispatch();
+    dispatch.program = program;
+    dispatch.functions = functions.size();
+    for (UniformFunctionsMap::iterator it = functions.begin(); it != functions.end(); ++it) {
+        if (!it->second.present || !it->second.assign)
+            continue;
+
+        UniformDispatchEntry entry;
+        entry.function = &it->second;
+        entry.location = getLocation(program, it->first);
+        entry.scene = ( it->first == "u_scene" || it->first == "u_sceneDepth" || it->first == "u_sceneNormal" || it->first == "u_scenePosition");
+
+        // present on the sources, but not used by this program (or optimized out)
+        if (program != 0 && entry.location == -1)
+            continue;
+
+        dispatch.entries.push_back(entry);
+    }
+
+    // Names built once here, feeding only goes by location
+    dispatch.buffers.resize(buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++)
+        dispatch.buffers[i] = getLocation(program, "u_buffer" + vera::toString(i));
+
+    dispatch.doubleBuffers.resize(doubleBuffers.size());
+    for (size_t i = 0; i < doubleBuffers.size(); i++)
+        dispatch.doubleBuffers[i] = getLocation(program, "u_doubleBuffer" + vera::toString(i));
+
+    dispatch.pyramids.resize(pyramids.size());
+    for (size_t i = 0; i < pyramids.size(); i++)
+        dispatch.pyramids[i] = getLocation(program, "u_pyramid" + vera::toString(i));
+
+    for (vera::TexturesMap::iterator it = textures.begin(); it != textures.end(); ++it) {
+        UniformSlotGroup group;
+        group.name = it->first;
+        group.locations.resize(SLOT_RESOLUTION + 1);
+        group.locations[SLOT_SAMPLER] = getLocation(program, it->first);
+        group.locations[SLOT_RESOLUTION] = getLocation(program, it->first + "Resolution");
+        dispatch.textures.push_back(group);
+    }
+
+    for (vera::TextureStreamsMap::iterator it = streams.begin(); it != streams.end(); ++it) {
+        UniformSlotGroup group;
+        group.name = it->first;
+        group.locations.resize(SLOT_PREV + it->second->getPrevTexturesTotal());
+        group.locations[SLOT_TIME] = getLocation(program, it->first + "Time");
+        group.locations[SLOT_FPS] = getLocation(program, it->first + "Fps");
+        group.locations[SLOT_DURATION] = getLocation(program, it->first + "Duration");
+        group.locations[SLOT_CURRENT_FRAME] = getLocation(program, it->first + "CurrentFrame");
+        group.locations[SLOT_TOTAL_FRAMES] = getLocation(program, it->first + "TotalFrames");
+        for (size_t i = 0; i < it->second->getPrevTexturesTotal(); i++)
+            group.locations[SLOT_PREV + i] = getLocation(program, it->first + "Prev[" + vera::toString(i) + "]");
+        dispatch.streams.push_back(group);
+    }
+
+    // a single light goes by u_light*, several by their own names
+    for (vera::LightsMap::iterator it = lights.begin(); it != lights.end(); ++it) {
+        std::string name = (lights.size() == 1)? "u_light" : "u_" + it->first;
+
+        UniformSlotGroup group;
+        group.name = it->first;
+        group.locations.resize(SLOT_SHADOWMAP + 1);
+        group.locations[SLOT_POSITION] = getLocation(program, name);
+        group.locations[SLOT_COLOR] = getLocation(program, name + "Color");
+        group.locations[SLOT_INTENSITY] = getLocation(program, name + "Intensity");
+        group.locations[SLOT_DIRECTION] = getLocation(program, name + "Direction");
+        group.locations[SLOT_FALLOFF] = getLocation(program, name + "Falloff");
+        group.locations[SLOT_MATRIX] = getLocation(program, name + "Matrix");
+        group.locations[SLOT_SHADOWMAP] = getLocation(program, name + "ShadowMap");
+        group.sampler = name + "ShadowMap";
+        dispatch.lights.push_back(group);
+    }
+
+    dispatch.cubeMap = getLocation(program, "u_cubeMap");
+
+    // a newly linked program, point its globals block (if it has one) to the shared buffer
+    globalsBlock.bind(program);
+
+    return dispatch;
+}
+
+void Uniforms::_bindTexture(GLint _location, GLenum _target, GLuint _id, vera::Shader *_shader) {
+    // samplers the program doesn't use don't take a unit
+    if (_location == -1)
+        return;
+
+    int unit = _shader->textureIndex++;
+    textureUnits.bind(unit, _target, _id);
+    glUniform1i(_location, unit);
+}
+
+void Uniforms::flagProgramsChange() {
+    m_dispatch.clear();
+}
+
+void Uniforms::feedBuffersTo(vera::Shader *_shader, int _skip) {
+    UniformDispatch& dispatch = _dispatch(_shader);
+
+    for (size_t i = 0; i < buffers.size(); i++)
+        if ((int)i != _skip)
+            _bindTexture(dispatch.buffers[i], GL_TEXTURE_2D, buffers[i].getTextureId(), _shader);
+
+    for (size_t i = 0; i < doubleBuffers.size(); i++)
+        _bindTexture(dispatch.doubleBuffers[i], GL_TEXTURE_2D, doubleBuffers[i].src->getTextureId(), _shader);
+}
+
 bool Uniforms::feedTo(vera::Shader *_shader, bool _lights, bool _buffers ) {
     bool update = false;
 
     // Pass Native uniforms 
-    for (UniformFunctionsMap::iterator it = functions.begin(); it != functions.end(); ++it) {
-        if (!_lights && ( it->first == "u_scene" || it->first == "u_sceneDepth" || it->first == "u_sceneNormal" || it->first == "u_scenePosition") )
+    UniformDispatch& dispatch = _dispatch(_shader);
+    int firstUnit = _shader->textureIndex;
+    for (size_t i = 0; i < dispatch.entries.size(); i++) {
+        if (!_lights && dispatch.entries[i].scene)
             continue;
 
-        if (it->second.present)
-            if (it->second.assign)
-                it->second.assign( *_shader );
+        dispatch.entries[i].function->assign( *_shader );
     }
+    // u_scene* textures are bound by vera behind our back
+    textureUnits.invalidate(firstUnit, _shader->textureIndex);
 
     // Pass User defined uniforms
     if (m_change) {
@@ -244,73 +411,76 @@ bool Uniforms::feedTo(vera::Shader *_shader, bool _lights, bool _buffers ) {
     }
 
     // Pass Textures Uniforms
-    for (vera::TexturesMap::iterator it = textures.begin(); it != textures.end(); ++it) {
-        _shader->setUniformTexture(it->first, it->second, _shader->textureIndex++ );
-        _shader->setUniform(it->first+"Resolution", float(it->second->getWidth()), float(it->second->getHeight()));
+    size_t index = 0;
+    for (vera::TexturesMap::iterator it = textures.begin(); it != textures.end(); ++it, index++) {
+        const std::vector<GLint>& slots = dispatch.textures[index].locations;
+        _bindTexture(slots[SLOT_SAMPLER], GL_TEXTURE_2D, it->second->getTextureId(), _shader);
+        if (slots[SLOT_RESOLUTION] != -1)
+            glUniform2f(slots[SLOT_RESOLUTION], float(it->second->getWidth()), float(it->second->getHeight()));
     }
 
-    for (vera::TextureStreamsMap::iterator it = streams.begin(); it != streams.end(); ++it) {
+    index = 0;
+    for (vera::TextureStreamsMap::iterator it = streams.begin(); it != streams.end(); ++it, index++) {
+        const std::vector<GLint>& slots = dispatch.streams[index].locations;
         for (size_t i = 0; i < it->second->getPrevTexturesTotal(); i++)
-            _shader->setUniformTexture(it->first+"Prev["+vera::toString(i)+"]", it->second->getPrevTextureId(i), _shader->textureIndex++);
-
-        _shader->setUniform(it->first+"Time", float(it->second->getTime()));
-        _shader->setUniform(it->first+"Fps", float(it->second->getFps()));
-        _shader->setUniform(it->first+"Duration", float(it->second->getDuration()));
-        _shader->setUniform(it->first+"CurrentFrame", float(it->second->getCurrentFrame()));
-        _shader->setUniform(it->first+"TotalFrames", float(it->second->getTotalFrames()));
+            _bindTexture(slots[SLOT_PREV + i], GL_TEXTURE_2D, it->second->getPrevTextureId(i), _shader);
+
+        if (slots[SLOT_TIME] != -1)
+            glUniform1f(slots[SLOT_TIME], float(it->second->getTime()));
+        if (slots[SLOT_FPS] != -1)
+            glUniform1f(slots[SLOT_FPS], float(it->second->getFps()));
+        if (slots[SLOT_DURATION] != -1)
+            glUniform1f(slots[SLOT_DURATION], float(it->second->getDuration()));
+        if (slots[SLOT_CURRENT_FRAME] != -1)
+            glUniform1f(slots[SLOT_CURRENT_FRAME], float(it->second->getCurrentFrame()));
+        if (slots[SLOT_TOTAL_FRAMES] != -1)
+            glUniform1f(slots[SLOT_TOTAL_FRAMES], float(it->second->getTotalFrames()));
     }
 
     // Pass Buffers Texture
-    if (_buffers) {
-        for (size_t i = 0; i < buffers.size(); i++)
-            _shader->setUniformTexture("u_buffer" + vera::toString(i), &buffers[i], _shader->textureIndex++ );
-
-        for (size_t i = 0; i < doubleBuffers.size(); i++)
-            _shader->setUniformTexture("u_doubleBuffer" + vera::toString(i), doubleBuffers[i].src, _shader->textureIndex++ );
-    }
+    if (_buffers)
+        feedBuffersTo(_shader);
 
     // Pass Convolution Piramids resultant Texture
     for (size_t i = 0; i < pyramids.size(); i++)
-        _shader->setUniformTexture("u_pyramid" + vera::toString(i), pyramids[i].getResult(), _shader->textureIndex++ );
+        _bindTexture(dispatch.pyramids[i], GL_TEXTURE_2D, pyramids[i].getResult()->getTextureId(), _shader);
     
     if (_lights) {
         // Pass Light Uniforms
-        if (lights.size() == 1) {
-            vera::LightsMap::iterator it = lights.begin();
-            _shader->setUniform("u_lightColor", it->second->color);
-            _shader->setUniform("u_lightIntensity", it->second->intensity);
-            if (it->second->getLightType() != vera::LIGHT_DIRECTIONAL)
-                _shader->setUniform("u_light", it->second->getPosition());
-            if (it->second->getLightType() == vera::LIGHT_DIRECTIONAL || it->second->getLightType() == vera::LIGHT_SPOT)
-                _shader->setUniform("u_lightDirection", it->second->direction);
-            if (it->second->falloff > 0)
-                _shader->setUniform("u_lightFalloff", it->second->falloff);
-            _shader->setUniform("u_lightMatrix", it->second->getBiasMVPMatrix() );
-            _shader->setUniformDepthTexture("u_lightShadowMap", it->second->getShadowMap(), _shader->textureIndex++ );
-        }
-        else {
-            // TODO:
-            //      - Lights should be pass as structs?? 
-
-            for (vera::LightsMap::iterator it = lights.begin(); it != lights.end(); ++it) {
-                std::string name = "u_" + it->first;
-
-                _shader->setUniform(name + "Color", it->second->color);
-                _shader->setUniform(name + "Intensity", it->second->intensity);
-                if (it->second->getLightType() != vera::LIGHT_DIRECTIONAL)
-                    _shader->setUniform(name, it->second->getPosition());
-                if (it->second->getLightType() == vera::LIGHT_DIRECTIONAL || it->second->getLightType() == vera::LIGHT_SPOT)
-                    _shader->setUniform(name + "Direction", it->second->direction);
-                if (it->second->falloff > 0)
-                    _shader->setUniform(name +"Falloff", it->second->falloff);
-
-                _shader->setUniform(name + "Matrix", it->second->getBiasMVPMatrix() );
-                _shader->setUniformDepthTexture(name + "ShadowMap", it->second->getShadowMap(), _shader->textureIndex++ );
+        index = 0;
+        for (vera::LightsMap::iterator it = lights.begin(); it != lights.end(); ++it, index++) {
+            const std::vector<GLint>& slots = dispatch.lights[index].locations;
+            vera::Light* light = it->second;
+
+            if (slots[SLOT_COLOR] != -1) {
+                glm::vec3 color = glm::vec3(light->color);
+                glUniform3f(slots[SLOT_COLOR], color.x, color.y, color.z);
+            }
+            if (slots[SLOT_INTENSITY] != -1)
+                glUniform1f(slots[SLOT_INTENSITY], light->intensity);
+            if (light->getLightType() != vera::LIGHT_DIRECTIONAL && slots[SLOT_POSITION] != -1) {
+                glm::vec3 position = light->getPosition();
+                glUniform3f(slots[SLOT_POSITION], position.x, position.y, position.z);
+            }
+            if ((light->getLightType() == vera::LIGHT_DIRECTIONAL || light->getLightType() == vera::LIGHT_SPOT) && slots[SLOT_DIRECTION] != -1) {
+                glm::vec3 direction = glm::vec3(light->direction);
+                glUniform3f(slots[SLOT_DIRECTION], direction.x, direction.y, direction.z);
+            }
+            if (light->falloff > 0 && slots[SLOT_FALLOFF] != -1)
+                glUniform1f(slots[SLOT_FALLOFF], light->falloff);
+            if (slots[SLOT_MATRIX] != -1)
+                glUniformMatrix4fv(slots[SLOT_MATRIX], 1, GL_FALSE, glm::value_ptr(light->getBiasMVPMatrix()));
+
+            if (light->getShadowMap() && slots[SLOT_SHADOWMAP] != -1) {
+                // vera picks the depth attachment (or the depth-as-color fallback on GLES) and its target
+                int unit = _shader->textureIndex++;
+                _shader->setUniformDepthTexture(dispatch.lights[index].sampler, light->getShadowMap(), unit);
+                textureUnits.invalidate(unit, unit + 1);
             }
         }
         
         if (activeCubemap) {
-            _shader->setUniformTextureCube("u_cubeMap", (vera::TextureCube*)activeCubemap);
+            _bindTexture(dispatch.cubeMap, GL_TEXTURE_CUBE_MAP, ((vera::TextureCube*)activeCubemap)->getTextureId(), _shader);
             _shader->setUniform("u_SH", activeCubemap->SH, 9);
         }
     }
@@ -359,7 +529,7 @@ bool Uniforms::haveChange() {
         if (it->second->bChange)
             return true;
 
-    if (m_change || streams.size() > 0)
+    if (m_change || streams.size() > 0 || !m_inbox.empty())
         return true;
 
     return false;
@@ -400,17 +570,126 @@ void Uniforms::set(const std::string& _name, float _x, float _y, float _z, float
     m_change = true;
 }
 
+void Uniforms::setNow(const std::string& _name, float _value) {
+    data[_name].discard();
+    set(_name, _value);
+}
+
 bool Uniforms::parseLine( const std::string &_line ) {
     std::vector<std::string> values = vera::split(_line,',');
     if (values.size() > 1) {
-        data[ values[0] ].parse(values, 1);
-        m_change = true;
-        return true;
+        float candidate[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (size_t i = 1; i < values.size() && i < 5; i++)
+            candidate[i-1] = vera::toFloat(values[i]);
+
+        return m_inbox.push(values[0], candidate, values.size() - 1, true);
     }
     return false;
 }
 
+void Uniforms::ingest() {
+    if (m_policiesChange.exchange(false)) {
+        std::lock_guard<std::mutex> lock(m_policiesMutex);
+        for (std::map<std::string, std::pair<UniformPolicy, size_t> >::iterator it = m_policies.begin(); it != m_policies.end(); ++it) {
+            UniformDataMap::iterator uniform = data.find(it->first);
+            if (uniform != data.end()) {
+                uniform->second.policy = it->second.first;
+                uniform->second.bound = it->second.second;
+            }
+        }
+    }
+
+    // the latest values of the coalesced uniforms, then the ones queued in order
+    UniformSample sample;
+    size_t slot = 0;
+    while (m_inbox.popLatest(slot, sample))
+        _ingest(sample);
+    while (m_inbox.pop(sample))
+        _ingest(sample);
+
+    // Each frame gets the mean of what arrived for averages, or the next value in line for queues
+    for (UniformDataMap::iterator it = data.begin(); it != data.end(); ++it) {
+        UniformData& uniform = it->second;
+        if (uniform.count > 0) {
+            for (size_t i = 0; i < 4; i++)
+                uniform.value[i] = uniform.sum[i] / float(uniform.count);
+            uniform.count = 0;
+            uniform.change = true;
+            m_change = true;
+        }
+
+        if (!uniform.queue.empty()) {
+            // switched away from queueing, only the last one counts
+            if (uniform.policy != UNIFORM_QUEUE) {
+                while (uniform.queue.size() > 1)
+                    uniform.queue.pop();
+            }
+            uniform.value = uniform.queue.front().value;
+            uniform.timestamp = uniform.queue.front().timestamp;
+            uniform.queue.pop();
+            uniform.change = true;
+            m_change = true;
+        }
+    }
+}
+
+// Uniforms are looked up by their inbox slot, only the first value of each one goes through the map
+void Uniforms::_ingest(const UniformSample& _sample) {
+    if (_sample.slot >= m_inboxData.size())
+        m_inboxData.resize(_sample.slot + 1, nullptr);
+
+    UniformData* uniform = m_inboxData[_sample.slot];
+    if (uniform == nullptr) {
+        const char* name = m_inbox.getName(_sample.slot);
+        UniformDataMap::iterator it = data.find(name);
+        if (it == data.end()) {
+            // first value of this uniform, it may already have a policy waiting for it
+            it = data.insert(std::make_pair(std::string(name), UniformData())).first;
+            std::lock_guard<std::mutex> lock(m_policiesMutex);
+            std::map<std::string, std::pair<UniformPolicy, size_t> >::iterator policy = m_policies.find(name);
+            if (policy != m_policies.end()) {
+                it->second.policy = policy->second.first;
+                it->second.bound = policy->second.second;
+            }
+        }
+        uniform = &it->second;
+        m_inboxData[_sample.slot] = uniform;
+    }
+
+    uniform->ingest(_sample);
+    m_change = true;
+}
+
+void Uniforms::setPolicy( const std::string& _name, UniformPolicy _policy, size_t _bound ) {
+    // values of the uniforms where only the latest counts don't need to wait in line
+    m_inbox.setCoalesce(_name, _policy == UNIFORM_LATEST);
+
+    std::lock_guard<std::mutex> lock(m_policiesMutex);
+    m_policies[_name] = std::make_pair(_policy, _bound);
+    m_policiesChange = true;
+}
+
+void Uniforms::printPolicies() {
+    const std::string names[] = { "latest", "average", "queue" };
+    double now = uniformClock();
+    for (UniformDataMap::iterator it = data.begin(); it != data.end(); ++it) {
+        std::cout << it->first << "," << names[it->second.policy];
+        if (it->second.policy == UNIFORM_QUEUE)
+            std::cout << "," << it->second.bound;
+        std::cout << " // received " << it->second.received;
+        std::cout << ", dropped " << it->second.dropped;
+        std::cout << ", waiting " << it->second.queue.size();
+        if (it->second.timestamp > 0.0)
+            std::cout << ", age " << vera::toString(float(now - it->second.timestamp) * 1000.0f, 1) << "ms";
+        std::cout << std::endl;
+    }
+    if (m_inbox.getDropped() > 0)
+        std::cout << "// " << m_inbox.getDropped() << " values dropped by the inbox" << std::endl;
+}
+
 void Uniforms::checkUniforms( const std::string &_vert_src, const std::string &_frag_src ) {
+    flagProgramsChange();
+
     // Check active native uniforms
     for (UniformFunctionsMap::iterator it = functions.begin(); it != functions.end(); ++it) {
         std::string name = it->first + ";";
@@ -470,11 +749,13 @@ void Uniforms::printDefinedUniforms(bool _csv){
 }
 
 void Uniforms::addDefine(const std::string& _define, const std::string& _value) {
+    flagProgramsChange();
     for (vera::ModelsMap::iterator it = models.begin(); it != models.end(); ++it)
         it->second->addDefine(_define, _value);
 }
 
 void Uniforms::delDefine(const std::string& _define) {
+    flagProgramsChange();
     for (vera::ModelsMap::iterator it = models.begin(); it != models.end(); ++it)
         it->second->delDefine(_define);
 }
@@ -519,6 +800,8 @@ void Uniforms::clearBuffers() {
 
 void Uniforms::clearUniforms() {
     data.clear();
+    m_inboxData.clear();
+    m_dispatch.clear();
 
     for (UniformFunctionsMap::iterator it = functions.begin(); it != functions.end(); ++it)
         it->second.present = false;
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <map>
+#include <mutex>
+#include <atomic>
 #include <queue>
 #include <array>
 #include <vector>
@@ -9,6 +11,9 @@
 
 #include "tools/files.h"
 #include "tools/tracker.h"
+#include "tools/globalsBlock.h"
+#include "tools/textureUnits.h"
+#include "tools/uniformInbox.h"
 
 #include "vera/types/scene.h"
 
@@ -21,18 +26,40 @@ typedef std::vector<CameraData> CameraPath;
 
 typedef std::array<float, 4> UniformValue;
 
+enum UniformPolicy {
+    UNIFORM_LATEST = 0,     // the last value that arrived before the frame
+    UNIFORM_AVERAGE,        // the mean of the values that arrived since the previous frame
+    UNIFORM_QUEUE           // one value per frame in arrival order, keeping at most `bound` waiting
+};
+
+struct UniformQueued {
+    UniformValue                        value;
+    double                              timestamp;
+};
+
 struct UniformData {
     std::string getType();
 
+    // Render thread only, other threads go through Uniforms::parseLine
     void    set(const UniformValue &_value, size_t _size, bool _int);
-    void    parse(const std::vector<std::string>& _command, size_t _start = 1);
+    void    ingest(const UniformSample &_sample);
+    void    discard();  // the values queued or being averaged
     bool    check();
 
-    std::queue<UniformValue>            queue;
+    std::queue<UniformQueued>           queue;
     UniformValue                        value;
     size_t                              size    = 0;
     bool                                bInt    = false;
     bool                                change  = false;
+
+    // Ingestion
+    UniformPolicy                       policy  = UNIFORM_LATEST;
+    size_t                              bound   = 64;
+    UniformValue                        sum;                // of the values to average
+    size_t                              count   = 0;
+    double                              timestamp = 0.0;    // arrival of the value in use, see uniformClock()
+    size_t                              received = 0;
+    size_t                              dropped = 0;
 };
 
 struct UniformFunction {
@@ -51,6 +78,42 @@ struct UniformFunction {
 typedef std::map<std::string, UniformData>      UniformDataMap;
 typedef std::map<std::string, UniformFunction>  UniformFunctionsMap;
 
+// The native uniforms one shader program actually uses, so feeding it every pass of every
+// frame doesn't walk (and string compare) all the functions
+struct UniformDispatchEntry {
+    UniformFunction*                    function;
+    GLint                               location;   // -1 when the program wasn't linked yet
+    bool                                scene;      // u_scene* textures, skipped without lights
+};
+
+// The uniforms named after a texture, stream or light, resolved once per program
+enum UniformSlotName {
+    SLOT_SAMPLER = 0, SLOT_RESOLUTION,                                          // textures
+    SLOT_TIME = 0, SLOT_FPS, SLOT_DURATION, SLOT_CURRENT_FRAME, SLOT_TOTAL_FRAMES, SLOT_PREV,  // streams (SLOT_PREV + i)
+    SLOT_POSITION = 0, SLOT_COLOR, SLOT_INTENSITY, SLOT_DIRECTION, SLOT_FALLOFF, SLOT_MATRIX, SLOT_SHADOWMAP   // lights
+};
+
+struct UniformSlotGroup {
+    std::string                         name;       // key of the texture, stream or light it was resolved for
+    std::vector<GLint>                  locations;  // by UniformSlotName
+    std::string                         sampler;    // set through vera (light shadow maps)
+};
+
+struct UniformDispatch {
+    std::vector<UniformDispatchEntry>   entries;
+    std::vector<GLint>                  buffers;        // locations of u_buffer<N>
+    std::vector<GLint>                  doubleBuffers;
+    std::vector<GLint>                  pyramids;
+    std::vector<UniformSlotGroup>       textures;
+    std::vector<UniformSlotGroup>       streams;
+    std::vector<UniformSlotGroup>       lights;
+    GLint                               cubeMap = -1;
+    GLuint                              program = 0;
+    size_t                              functions = 0;
+};
+
+typedef std::map<const vera::Shader*, UniformDispatch>  UniformDispatchMap;
+
 // Buffers types
 typedef std::vector<vera::Fbo>                  BuffersList;
 typedef std::vector<vera::PingPong>             DoubleBuffersList;
@@ -71,6 +134,12 @@ public:
     // Feed uniforms to a specific shader
     virtual bool        feedTo( vera::Shader *_shader, bool _lights = true, bool _buffers = true);
 
+    // Feed the buffers and double buffers textures, all but buffer _skip (the one being rendered)
+    virtual void        feedBuffersTo( vera::Shader *_shader, int _skip = -1);
+
+    // Shaders were recompiled (new sources or defines), their dispatch tables are rebuilt on the next feedTo
+    virtual void        flagProgramsChange();
+
     // defines
     virtual void        addDefine(const std::string& _define, const std::string& _value);
     virtual void        delDefine(const std::string& _define);
@@ -91,19 +160,45 @@ public:
     virtual void        set( const std::string& _name, float _x, float _y);
     virtual void        set( const std::string& _name, float _x, float _y, float _z);
     virtual void        set( const std::string& _name, float _x, float _y, float _z, float _w);
+    // Render thread only, the value is used from this frame on instead of what was queued or being averaged
+    virtual void        setNow( const std::string& _name, float _value);
     virtual void        checkUniforms( const std::string &_vert_src, const std::string &_frag_src );
+
+    // Values from the console and OSC threads wait in an inbox until the render thread
+    // ingests them at the start of the next frame, coalesced by the policy of each uniform
     virtual bool        parseLine( const std::string &_line );
+    virtual void        ingest();
+    virtual void        setPolicy( const std::string& _name, UniformPolicy _policy, size_t _bound = 64 );
+    virtual void        printPolicies();
     virtual void        clearUniforms();
     virtual void        printAvailableUniforms(bool _non_active);
     virtual void        printDefinedUniforms(bool _csv = false);
     
 
+    // Opt-in uniform buffer with the per-frame globals, shared by all programs
+    GlobalsBlock        globalsBlock;
+
+    // Textures bound by the passes, batched by Sandbox while rendering the buffers
+    TextureUnits        textureUnits;
+
     CameraPath          cameraPath;
     virtual bool        addCameraPath( const std::string& _name );
 
     Tracker             tracker;
 
 protected:
+    UniformDispatch&    _dispatch( vera::Shader *_shader );
+    bool                _dispatchValid( const UniformDispatch& _dispatch, GLuint _program ) const;
+    void                _bindTexture( GLint _location, GLenum _target, GLuint _id, vera::Shader *_shader );
+    void                _ingest( const UniformSample& _sample );
+
+    UniformDispatchMap  m_dispatch;
+
+    UniformInbox        m_inbox;
+    std::vector<UniformData*>   m_inboxData;    // by inbox slot, resolved on their first value
+    std::map<std::string, std::pair<UniformPolicy, size_t> >   m_policies;
+    std::mutex          m_policiesMutex;
+    std::atomic<bool>   m_policiesChange;
     bool                m_change;
 
 };
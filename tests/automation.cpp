@@ -0,0 +1,163 @@
+#include "check.h"
+
+#include <map>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "automation.h"
+
+struct Applied {
+    std::array<float, 4>    value;
+    size_t                  size;
+    bool                    bInt;
+};
+
+static std::map<std::string, Applied> applyAt(const UniformAutomation& _automation, float _time) {
+    std::map<std::string, Applied> applied;
+    _automation.apply(_time, [&applied](const std::string& _name, const std::array<float, 4>& _value, size_t _size, bool _int) {
+        Applied a = { _value, _size, _int };
+        applied[_name] = a;
+    });
+    return applied;
+}
+
+static void capture1(UniformAutomation& _automation, const std::string& _name, float _value, float _time, size_t _frame) {
+    _automation.capture(_name, &_value, 1, false, _time, _frame);
+}
+
+static void testCapture() {
+    UniformAutomation automation;
+    capture1(automation, "u_a", 1.0f, 0.0f, 0);     // not recording yet
+    CHECK(automation.getTracks() == 0);
+
+    automation.record("test.gvat");
+    CHECK(automation.isRecording());
+    capture1(automation, "u_a", 1.0f, 0.0f, 0);
+    capture1(automation, "u_a", 1.0f, 0.5f, 15);    // re-sent, no key
+    capture1(automation, "u_a", 2.0f, 1.0f, 30);
+    capture1(automation, "u_a", 3.0f, 1.0f, 30);    // same frame, the last one wins
+    capture1(automation, "u_a", 4.0f, 2.0f, 60);
+
+    float color[6] = { 0.1f, 0.2f, 0.3f, 1.0f, 9.0f, 9.0f };
+    automation.capture("u_color", color, 6, false, 0.25f, 7);
+    float mode[1] = { 2.0f };
+    automation.capture("u_mode", mode, 1, true, 1.5f, 45);
+
+    CHECK(automation.getTracks() == 3);
+    CHECK(automation.getKeys() == 3 + 1 + 1);
+    CHECK(automation.getDuration() == 2.0f);
+    CHECK(automation.stop());
+    CHECK(!automation.isRecording());
+    CHECK(!automation.stop());
+}
+
+// What was recorded plays back the same from the file
+static void testRoundTrip() {
+    UniformAutomation automation;
+    CHECK(automation.load("test.gvat", AUTOMATION_STEP));
+    CHECK(automation.isPlaying());
+    CHECK(automation.getFile() == "test.gvat");
+    CHECK(automation.getInterpolation() == AUTOMATION_STEP);
+    CHECK(automation.getTracks() == 3);
+    CHECK(automation.getKeys() == 5);
+    CHECK(automation.getDuration() == 2.0f);
+
+    std::map<std::string, Applied> applied = applyAt(automation, 1.2f);
+    CHECK(applied.size() == 3);
+    CHECK(applied["u_a"].value[0] == 3.0f);
+    CHECK(applied["u_a"].size == 1 && !applied["u_a"].bInt);
+    CHECK(applied["u_color"].size == 4);
+    CHECK(applied["u_color"].value[0] == 0.1f && applied["u_color"].value[1] == 0.2f);
+    CHECK(applied["u_color"].value[2] == 0.3f && applied["u_color"].value[3] == 1.0f);
+    CHECK(applied["u_mode"].bInt && applied["u_mode"].value[0] == 2.0f);
+
+    // before the first key holds it, after the last one too
+    CHECK(applyAt(automation, -1.0f)["u_a"].value[0] == 1.0f);
+    CHECK(applyAt(automation, 0.99f)["u_a"].value[0] == 1.0f);
+    CHECK(applyAt(automation, 1.0f)["u_a"].value[0] == 3.0f);
+    CHECK(applyAt(automation, 10.0f)["u_a"].value[0] == 4.0f);
+
+    automation.clear();
+    CHECK(!automation.isPlaying());
+    CHECK(automation.getTracks() == 0);
+    CHECK(applyAt(automation, 1.0f).empty());
+}
+
+static void testInterpolation() {
+    UniformAutomation automation;
+    automation.record("test_interpolation.gvat");
+    const float ramp[4] = { 0.0f, 10.0f, 20.0f, 30.0f };
+    const float wave[4] = { 0.0f, 10.0f, 0.0f, 10.0f };
+    for (size_t i = 0; i < 4; i++) {
+        capture1(automation, "u_ramp", ramp[i], (float)i, i * 30);
+        capture1(automation, "u_wave", wave[i], (float)i, i * 30);
+    }
+    CHECK(automation.stop());
+    CHECK(automation.load("test_interpolation.gvat"));
+    CHECK(automation.getInterpolation() == AUTOMATION_LINEAR);
+    remove("test_interpolation.gvat");
+
+    CHECK_NEAR(applyAt(automation, 1.5f)["u_ramp"].value[0], 15.0f, 1e-5);
+    CHECK_NEAR(applyAt(automation, 0.25f)["u_wave"].value[0], 2.5f, 1e-5);
+
+    automation.setInterpolation(AUTOMATION_STEP);
+    CHECK(applyAt(automation, 1.5f)["u_ramp"].value[0] == 10.0f);
+    CHECK(applyAt(automation, 2.99f)["u_wave"].value[0] == 0.0f);
+
+    // splines go through every key and follow straight lines
+    automation.setInterpolation(AUTOMATION_SPLINE);
+    for (size_t i = 0; i < 4; i++) {
+        CHECK_NEAR(applyAt(automation, (float)i)["u_ramp"].value[0], ramp[i], 1e-5);
+        CHECK_NEAR(applyAt(automation, (float)i)["u_wave"].value[0], wave[i], 1e-5);
+    }
+    CHECK_NEAR(applyAt(automation, 1.5f)["u_ramp"].value[0], 15.0f, 1e-4);
+    CHECK_NEAR(applyAt(automation, 1.25f)["u_ramp"].value[0], 12.5f, 1e-4);
+
+    // and are smooth: between the two peaks the wave bends, past the values a line would give
+    float middle = applyAt(automation, 1.5f)["u_wave"].value[0];
+    CHECK_NEAR(middle, 5.0f, 1e-4);
+    CHECK(applyAt(automation, 1.25f)["u_wave"].value[0] > 7.5f);
+}
+
+static void testErrors() {
+    UniformAutomation automation;
+    CHECK(!automation.load("test_missing.gvat"));
+    CHECK(!automation.isPlaying());
+
+    FILE* file = fopen("test_bad.gvat", "wb");
+    fputs("GVXX", file);
+    fclose(file);
+    CHECK(!automation.load("test_bad.gvat"));
+
+    // cut in the middle of a key
+    std::vector<unsigned char> bytes;
+    file = fopen("test.gvat", "rb");
+    CHECK(file != nullptr);
+    if (file) {
+        int c;
+        while ((c = fgetc(file)) != EOF)
+            bytes.push_back((unsigned char)c);
+        fclose(file);
+    }
+    file = fopen("test_bad.gvat", "wb");
+    fwrite(bytes.data(), 1, bytes.size() - 3, file);
+    fclose(file);
+    CHECK(!automation.load("test_bad.gvat"));
+    CHECK(automation.getTracks() == 0);
+    CHECK(!automation.isPlaying());
+    remove("test_bad.gvat");
+
+    CHECK(toAutomationInterpolation(toString(AUTOMATION_STEP)) == AUTOMATION_STEP);
+    CHECK(toAutomationInterpolation(toString(AUTOMATION_LINEAR)) == AUTOMATION_LINEAR);
+    CHECK(toAutomationInterpolation(toString(AUTOMATION_SPLINE)) == AUTOMATION_SPLINE);
+}
+
+int main() {
+    testCapture();
+    testRoundTrip();
+    testInterpolation();
+    testErrors();
+    remove("test.gvat");
+    return checkResult("automation");
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal checks for the unit tests, each test is its own executable that
+// returns the number of failed checks
+static int s_failed = 0;
+
+#define CHECK(_expr) \
+    do { \
+        if (!(_expr)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #_expr ") failed" << std::endl; \
+            s_failed++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(_a, _b, _epsilon) \
+    do { \
+        double a_ = (double)(_a), b_ = (double)(_b); \
+        if (a_ - b_ > (_epsilon) || b_ - a_ > (_epsilon)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_NEAR(" #_a ", " #_b ") failed, " << a_ << " != " << b_ << std::endl; \
+            s_failed++; \
+        } \
+    } while (0)
+
+inline int checkResult(const char* _name) {
+    if (s_failed == 0)
+        std::cout << _name << ": ok" << std::endl;
+    else
+        std::cerr << _name << ": " << s_failed << " checks failed" << std::endl;
+    return s_failed;
+}
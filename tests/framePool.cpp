@@ -0,0 +1,119 @@
+#include "check.h"
+
+#include <thread>
+#include <vector>
+
+#include "framePool.h"
+
+static void testAllocate() {
+    FramePool pool;
+    pool.allocate(64, 3);
+    CHECK(pool.getFree(64) == 3);
+    CHECK(pool.getAllocations() == 3);
+
+    // topping up only allocates what is missing
+    pool.allocate(64, 4);
+    CHECK(pool.getFree(64) == 4);
+    CHECK(pool.getAllocations() == 4);
+    pool.allocate(64, 2);
+    CHECK(pool.getFree(64) == 4);
+    CHECK(pool.getAllocations() == 4);
+}
+
+static void testRecycle() {
+    FramePool pool;
+    pool.allocate(64, 2);
+
+    Pixels a = pool.acquire(64);
+    Pixels b = pool.acquire(64);
+    CHECK(a && b && a.get() != b.get());
+    CHECK(pool.getFree(64) == 0);
+    CHECK(pool.getAllocations() == 2);
+
+    // the same buffers come back, without allocating
+    unsigned char* address = a.get();
+    pool.release(std::move(a), 64);
+    CHECK(!a);
+    CHECK(pool.getFree(64) == 1);
+    Pixels c = pool.acquire(64);
+    CHECK(c.get() == address);
+    CHECK(pool.getAllocations() == 2);
+
+    // running out allocates a new one
+    Pixels d = pool.acquire(64);
+    CHECK(d);
+    CHECK(pool.getAllocations() == 3);
+
+    pool.release(std::move(b), 64);
+    pool.release(std::move(c), 64);
+    pool.release(std::move(d), 64);
+    CHECK(pool.getFree(64) == 3);
+
+    // releasing nothing is fine
+    pool.release(Pixels(), 64);
+    CHECK(pool.getFree(64) == 3);
+}
+
+static void testSizes() {
+    FramePool pool;
+    pool.allocate(16, 2);
+    pool.allocate(32, 1);
+    CHECK(pool.getFree(16) == 2);
+    CHECK(pool.getFree(32) == 1);
+    CHECK(pool.getFree(48) == 0);
+
+    // sizes don't mix and a new size doesn't drop the others
+    Pixels small = pool.acquire(16);
+    Pixels big = pool.acquire(32);
+    CHECK(pool.getAllocations() == 3);
+    Pixels other = pool.acquire(48);
+    CHECK(pool.getAllocations() == 4);
+    CHECK(pool.getFree(16) == 1);
+
+    pool.release(std::move(small), 16);
+    pool.release(std::move(big), 32);
+    pool.release(std::move(other), 48);
+    CHECK(pool.getFree(16) == 2);
+    CHECK(pool.getFree(32) == 1);
+    CHECK(pool.getFree(48) == 1);
+
+    // buffers in use when the pool is cleared are freed as they come back
+    Pixels inUse = pool.acquire(16);
+    pool.clear();
+    CHECK(pool.getFree(16) == 0);
+    CHECK(pool.getFree(32) == 0);
+    pool.release(std::move(inUse), 16);
+    CHECK(!inUse);
+    CHECK(pool.getFree(16) == 0);
+}
+
+// Buffers acquired on one thread and released from others
+static void testThreads() {
+    FramePool pool;
+    pool.allocate(128, 8);
+
+    std::vector<std::thread> savers;
+    for (int t = 0; t < 4; t++) {
+        savers.push_back(std::thread([&pool]() {
+            for (int i = 0; i < 1000; i++) {
+                Pixels pixels = pool.acquire(128);
+                pixels[0] = (unsigned char)i;
+                pool.release(std::move(pixels), 128);
+            }
+        }));
+    }
+    for (size_t t = 0; t < savers.size(); t++)
+        savers[t].join();
+
+    // never more buffers than threads holding them at once, beyond the warm ones
+    CHECK(pool.getAllocations() <= 8 + 4);
+    CHECK(pool.getFree(128) == pool.getAllocations());
+}
+
+int main() {
+    testAllocate();
+    testRecycle();
+    testSizes();
+    testThreads();
+    return checkResult("framePool");
+}
@@ -0,0 +1,144 @@
+#include "check.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frameStream.h"
+#include "yuv420.h"
+
+static std::vector<unsigned char> readFile(const std::string& _path) {
+    std::vector<unsigned char> bytes;
+    FILE* file = fopen(_path.c_str(), "rb");
+    if (!file)
+        return bytes;
+    unsigned char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+    return bytes;
+}
+
+static uint32_t readLE32(const unsigned char* _data) {
+    return _data[0] | (_data[1] << 8) | (_data[2] << 16) | ((uint32_t)_data[3] << 24);
+}
+
+static std::vector<unsigned char> makePixels(int _width, int _height, unsigned char _seed) {
+    std::vector<unsigned char> pixels((size_t)_width * _height * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (unsigned char)(i * 13 + _seed);
+    return pixels;
+}
+
+static void testY4M() {
+    const int width = 6;
+    const int height = 4;
+    std::vector<unsigned char> planes(getYUV420Bytes(width, height), 77);
+
+    FrameStream stream;
+    CHECK(stream.open("test.y4m", STREAM_Y4M));
+    size_t first = stream.write(planes.data(), width, height, 29.97f);
+    CHECK(first > 6 + planes.size());
+    CHECK(stream.write(planes.data(), width, height, 29.97f) == 6 + planes.size());
+
+    // frames can't change size
+    CHECK(stream.write(planes.data(), width + 2, height, 29.97f) == 0);
+    CHECK(stream.getFrames() == 2);
+    stream.close();
+
+    std::vector<unsigned char> bytes = readFile("test.y4m");
+    std::string header = "YUV4MPEG2 W6 H4 F30000:1001 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+    CHECK(bytes.size() == header.size() + 2 * (6 + planes.size()));
+    CHECK(std::string(bytes.begin(), bytes.begin() + header.size()) == header);
+    CHECK(std::string(bytes.begin() + header.size(), bytes.begin() + header.size() + 6) == "FRAME\n");
+    remove("test.y4m");
+
+    // and need an even size
+    CHECK(stream.open("test.y4m", STREAM_Y4M));
+    CHECK(stream.write(planes.data(), 5, 4, 30.0f) == 0);
+    CHECK(!stream.isOpen());
+    remove("test.y4m");
+}
+
+static void testFps() {
+    const float fps[4] = { 24.0f, 23.976f, 12.5f, 59.94f };
+    const char* fractions[4] = { "F24:1", "F24000:1001", "F25:2", "F60000:1001" };
+    std::vector<unsigned char> planes(getYUV420Bytes(2, 2), 0);
+    for (int i = 0; i < 4; i++) {
+        FrameStream stream;
+        CHECK(stream.open("test_fps.y4m", STREAM_Y4M));
+        CHECK(stream.write(planes.data(), 2, 2, fps[i]) > 0);
+        stream.close();
+
+        std::vector<unsigned char> bytes = readFile("test_fps.y4m");
+        std::string header(bytes.begin(), bytes.end());
+        CHECK(header.find(std::string(" ") + fractions[i] + " ") != std::string::npos);
+    }
+    remove("test_fps.y4m");
+}
+
+static void testRGBA() {
+    const int sizes[3][2] = { {3, 2}, {3, 2}, {5, 1} };
+    std::vector< std::vector<unsigned char> > frames;
+
+    FrameStream stream;
+    CHECK(stream.open("test.rgba", STREAM_RGBA));
+    for (int i = 0; i < 3; i++) {
+        frames.push_back(makePixels(sizes[i][0], sizes[i][1], (unsigned char)i));
+        // raw frames can change size
+        CHECK(stream.write(frames[i].data(), sizes[i][0], sizes[i][1], 12.5f) == FRAME_STREAM_HEADER_BYTES + frames[i].size());
+    }
+    CHECK(stream.getFrames() == 3);
+    stream.close();
+
+    std::vector<unsigned char> bytes = readFile("test.rgba");
+    size_t p = 0;
+    for (int i = 0; i < 3; i++) {
+        CHECK(p + FRAME_STREAM_HEADER_BYTES <= bytes.size());
+        if (p + FRAME_STREAM_HEADER_BYTES > bytes.size())
+            return;
+        const unsigned char* header = &bytes[p];
+        int width = sizes[i][0];
+        int height = sizes[i][1];
+        CHECK(std::string(header, header + 4) == "GVRF");
+        CHECK(readLE32(header + 4) == (uint32_t)width);
+        CHECK(readLE32(header + 8) == (uint32_t)height);
+        CHECK(readLE32(header + 12) == 25 && readLE32(header + 16) == 2);
+        CHECK(readLE32(header + 20) == (uint32_t)i && readLE32(header + 24) == 0);
+        CHECK(readLE32(header + 28) == frames[i].size());
+        p += FRAME_STREAM_HEADER_BYTES;
+
+        // rows top-down
+        size_t stride = (size_t)width * 4;
+        bool same = p + frames[i].size() <= bytes.size();
+        for (int y = 0; y < height && same; y++)
+            same = std::equal(&frames[i][(size_t)(height - 1 - y) * stride], &frames[i][(size_t)(height - 1 - y) * stride] + stride, &bytes[p + y * stride]);
+        CHECK(same);
+        p += frames[i].size();
+    }
+    CHECK(p == bytes.size());
+    remove("test.rgba");
+}
+
+static void testFormats() {
+    CHECK(toFrameStreamFormat("raw") == STREAM_RGBA);
+    CHECK(toFrameStreamFormat("rgba") == STREAM_RGBA);
+    CHECK(toFrameStreamFormat("y4m") == STREAM_Y4M);
+    CHECK(toString(STREAM_RGBA) == "raw");
+    CHECK(toString(STREAM_Y4M) == "y4m");
+
+    FrameStream stream;
+    unsigned char pixel[4] = { 0, 0, 0, 0 };
+    CHECK(stream.write(pixel, 1, 1, 30.0f) == 0);
+}
+
+int main() {
+    testY4M();
+    testFps();
+    testRGBA();
+    testFormats();
+    return checkResult("frameStream");
+}
@@ -0,0 +1,144 @@
+#include "check.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "globalsBlock.h"
+
+struct Member {
+    std::string name;
+    size_t      offset;
+};
+
+// The members of GlobalsData, as the GLSL block names them
+static const Member s_members[] = {
+    { "u_date",                     offsetof(GlobalsData, date) },
+    { "u_resolution",               offsetof(GlobalsData, resolution) },
+    { "u_mouse",                    offsetof(GlobalsData, mouse) },
+    { "u_time",                     offsetof(GlobalsData, time) },
+    { "u_delta",                    offsetof(GlobalsData, delta) },
+    { "u_frame",                    offsetof(GlobalsData, frame) },
+    { "u_cameraDistance",           offsetof(GlobalsData, cameraDistance) },
+    { "u_camera",                   offsetof(GlobalsData, camera) },
+    { "u_cameraNearClip",           offsetof(GlobalsData, cameraNearClip) },
+    { "u_cameraFarClip",            offsetof(GlobalsData, cameraFarClip) },
+    { "u_cameraExposure",           offsetof(GlobalsData, cameraExposure) },
+    { "u_cameraEv100",              offsetof(GlobalsData, cameraEv100) },
+    { "u_iblLuminance",             offsetof(GlobalsData, iblLuminance) },
+    { "u_viewMatrix",               offsetof(GlobalsData, viewMatrix) },
+    { "u_inverseViewMatrix",        offsetof(GlobalsData, inverseViewMatrix) },
+    { "u_projectionMatrix",         offsetof(GlobalsData, projectionMatrix) },
+    { "u_inverseProjectionMatrix",  offsetof(GlobalsData, inverseProjectionMatrix) },
+    { "u_normalMatrix",             offsetof(GlobalsData, normalMatrix) },
+    { "u_light",                    offsetof(GlobalsData, light) },
+    { "u_lightIntensity",           offsetof(GlobalsData, lightIntensity) },
+    { "u_lightColor",               offsetof(GlobalsData, lightColor) },
+    { "u_lightFalloff",             offsetof(GlobalsData, lightFalloff) },
+    { "u_lightDirection",           offsetof(GlobalsData, lightDirection) },
+    { "u_globalsPadding",           offsetof(GlobalsData, padding) },
+    { "u_lightMatrix",              offsetof(GlobalsData, lightMatrix) },
+};
+static const size_t s_count = sizeof(s_members) / sizeof(Member);
+
+// std140 base alignment and size of the types the block uses
+static bool getLayout(const std::string& _type, size_t& _align, size_t& _size) {
+    if (_type == "float" || _type == "int" || _type == "uint" || _type == "bool") {
+        _align = 4; _size = 4;
+    }
+    else if (_type == "vec2" || _type == "ivec2") {
+        _align = 8; _size = 8;
+    }
+    else if (_type == "vec3" || _type == "ivec3") {
+        _align = 16; _size = 12;
+    }
+    else if (_type == "vec4" || _type == "ivec4") {
+        _align = 16; _size = 16;
+    }
+    else if (_type == "mat3") {
+        _align = 16; _size = 3 * 16;    // columns are padded to vec4
+    }
+    else if (_type == "mat4") {
+        _align = 16; _size = 4 * 16;
+    }
+    else
+        return false;
+    return true;
+}
+
+// Lays out the members of the block in getSource() by the std140 rules
+static bool parseBlock(const std::string& _source, std::vector<Member>& _members, size_t& _size) {
+    std::istringstream in(_source);
+    std::string line;
+    bool inside = false;
+    size_t offset = 0;
+    while (std::getline(in, line)) {
+        if (line.find("layout(std140) uniform GlslViewerGlobals") != std::string::npos) {
+            inside = true;
+            continue;
+        }
+        if (!inside)
+            continue;
+        if (line.find("};") != std::string::npos) {
+            _size = (offset + 15) / 16 * 16;
+            return true;
+        }
+
+        std::istringstream words(line);
+        std::string type, name;
+        if (!(words >> type >> name) || name.empty() || name[name.size() - 1] != ';')
+            return false;
+        name.erase(name.size() - 1);
+
+        size_t align, size;
+        if (!getLayout(type, align, size))
+            return false;
+        offset = (offset + align - 1) / align * align;
+        Member member = { name, offset };
+        _members.push_back(member);
+        offset += size;
+    }
+    return false;
+}
+
+static void testLayout() {
+    std::vector<Member> members;
+    size_t size = 0;
+    CHECK(parseBlock(GlobalsBlock::getSource(), members, size));
+    CHECK(members.size() == s_count);
+    CHECK(size == sizeof(GlobalsData));
+
+    for (size_t i = 0; i < members.size() && i < s_count; i++) {
+        if (members[i].name != s_members[i].name || members[i].offset != s_members[i].offset)
+            std::cerr << members[i].name << " is at " << members[i].offset << " in the block, " << s_members[i].name << " at " << s_members[i].offset << " in GlobalsData" << std::endl;
+        CHECK(members[i].name == s_members[i].name);
+        CHECK(members[i].offset == s_members[i].offset);
+    }
+}
+
+static void testSource() {
+    std::string source = GlobalsBlock::getSource();
+    CHECK(source.find("#ifndef GLSLVIEWER_GLOBALS") != std::string::npos);
+
+    CHECK(GlobalsBlock::save("test_globals.glsl"));
+    std::ifstream in("test_globals.glsl");
+    std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    CHECK(saved == source);
+    remove("test_globals.glsl");
+
+    // without a context the block is just disabled
+    GlobalsBlock block;
+    CHECK(!block.isEnabled());
+    block.bind(0);
+    block.clear();
+}
+
+int main() {
+    testLayout();
+    testSource();
+    return checkResult("globalsBlock");
+}
@@ -0,0 +1,275 @@
+#include "check.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include <zlib.h>
+
+#include "imageEncoder.h"
+
+struct ExrImage {
+    int                             width       = 0;
+    int                             height      = 0;
+    int                             compression = -1;
+    std::vector<std::string>        names;
+    std::vector<int>                types;      // 1 half, 2 float
+    std::vector< std::vector<float> > channels; // top-down
+};
+
+static uint32_t readLE32(const unsigned char* _data) {
+    return _data[0] | (_data[1] << 8) | (_data[2] << 16) | ((uint32_t)_data[3] << 24);
+}
+
+static float halfToFloat(uint16_t _half) {
+    int exponent = (_half >> 10) & 0x1F;
+    int mantissa = _half & 0x3FF;
+    float value;
+    if (exponent == 0)
+        value = std::ldexp((float)mantissa, -24);
+    else if (exponent == 31)
+        value = mantissa? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+    else
+        value = std::ldexp((float)(mantissa + 1024), exponent - 25);
+    return (_half & 0x8000)? -value : value;
+}
+
+// Reads the scanline EXR files glslViewer writes (uncompressed, ZIPS or ZIP)
+static bool decodeEXR(const std::string& _path, ExrImage& _image) {
+    FILE* file = fopen(_path.c_str(), "rb");
+    if (!file)
+        return false;
+    std::vector<unsigned char> bytes;
+    unsigned char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+
+    if (bytes.size() < 8 || readLE32(&bytes[0]) != 20000630 || bytes[4] != 2)
+        return false;
+
+    // attributes, up to an empty name
+    size_t p = 8;
+    while (p < bytes.size() && bytes[p] != 0) {
+        std::string name((const char*)&bytes[p]);
+        p += name.size() + 1;
+        std::string type((const char*)&bytes[p]);
+        p += type.size() + 1;
+        uint32_t size = readLE32(&bytes[p]);
+        p += 4;
+        const unsigned char* value = &bytes[p];
+
+        if (name == "channels") {
+            for (size_t c = 0; value[c] != 0; c += 16) {
+                std::string channel((const char*)&value[c]);
+                c += channel.size() + 1;
+                _image.names.push_back(channel);
+                _image.types.push_back((int)readLE32(&value[c]));
+            }
+        }
+        else if (name == "compression")
+            _image.compression = value[0];
+        else if (name == "dataWindow") {
+            _image.width = readLE32(&value[8]) - readLE32(&value[0]) + 1;
+            _image.height = readLE32(&value[12]) - readLE32(&value[4]) + 1;
+        }
+        p += size;
+    }
+    p++;
+
+    if (_image.width <= 0 || _image.height <= 0 || _image.names.empty())
+        return false;
+
+    int lines = (_image.compression == 3)? 16 : 1;
+    int chunks = (_image.height + lines - 1) / lines;
+    size_t pixelBytes = 0;
+    for (size_t c = 0; c < _image.types.size(); c++)
+        pixelBytes += (_image.types[c] == 2)? 4 : 2;
+
+    _image.channels.assign(_image.names.size(), std::vector<float>((size_t)_image.width * _image.height));
+    for (int i = 0; i < chunks; i++) {
+        uint64_t offset = readLE32(&bytes[p + i * 8]) | ((uint64_t)readLE32(&bytes[p + i * 8 + 4]) << 32);
+        if (offset + 8 > bytes.size())
+            return false;
+        int y0 = (int)readLE32(&bytes[offset]);
+        uint32_t size = readLE32(&bytes[offset + 4]);
+        const unsigned char* data = &bytes[offset + 8];
+        if (y0 != i * lines || offset + 8 + size > bytes.size())
+            return false;
+
+        int rows = std::min(lines, _image.height - y0);
+        std::vector<unsigned char> raw((size_t)rows * _image.width * pixelBytes);
+        if (size < raw.size()) {
+            // undo the deltas and the split of even and odd bytes
+            std::vector<unsigned char> tmp(raw.size());
+            uLongf length = (uLongf)tmp.size();
+            if (uncompress(tmp.data(), &length, data, size) != Z_OK || length != tmp.size())
+                return false;
+            for (size_t j = 1; j < tmp.size(); j++)
+                tmp[j] = (unsigned char)(tmp[j - 1] + tmp[j] - 128);
+            size_t half = (tmp.size() + 1) / 2;
+            for (size_t j = 0; j < raw.size(); j++)
+                raw[j] = tmp[(j & 1)? half + j / 2 : j / 2];
+        }
+        else if (size == raw.size())
+            memcpy(raw.data(), data, size);
+        else
+            return false;
+
+        const unsigned char* src = raw.data();
+        for (int y = y0; y < y0 + rows; y++)
+            for (size_t c = 0; c < _image.names.size(); c++)
+                for (int x = 0; x < _image.width; x++) {
+                    float value;
+                    if (_image.types[c] == 2) {
+                        memcpy(&value, src, 4);
+                        src += 4;
+                    }
+                    else {
+                        value = halfToFloat((uint16_t)(src[0] | (src[1] << 8)));
+                        src += 2;
+                    }
+                    _image.channels[c][(size_t)y * _image.width + x] = value;
+                }
+    }
+    return true;
+}
+
+// Rounding a float to half: exact, to the nearest even or out of range
+static const float s_values[] = {
+    0.0f, -0.0f, 1.0f, -2.0f, 0.5f, 65504.0f, -65504.0f,
+    6.103515625e-05f,               // smallest normal
+    5.9604644775390625e-08f,        // smallest subnormal
+    1.0f + 1.0f / 2048.0f,          // tie, rounds down to even
+    1.0f + 3.0f / 2048.0f,          // tie, rounds up to even
+    2.98023223876953125e-08f,       // half the smallest subnormal, rounds to zero
+    8.94069671630859375e-08f,       // tie between subnormals, rounds up to even
+    65520.0f, 1.0e6f, -1.0e6f,      // overflow to infinity
+    1.0e-9f, -1.0e-9f,              // underflow to (signed) zero
+    0.1f, 3.14159265f, -123.456f, 1.0e-6f
+};
+static const int s_count = sizeof(s_values) / sizeof(float);
+
+static float expected(float _value) {
+    if (_value == 1.0f + 1.0f / 2048.0f)            return 1.0f;
+    if (_value == 1.0f + 3.0f / 2048.0f)            return 1.0f + 4.0f / 2048.0f;
+    if (_value == 2.98023223876953125e-08f)         return 0.0f;
+    if (_value == 8.94069671630859375e-08f)         return 1.1920928955078125e-07f;
+    if (std::fabs(_value) >= 65520.0f)              return (_value > 0.0f)? INFINITY : -INFINITY;
+    if (std::fabs(_value) < 2.98023223876953125e-08f) return std::copysign(0.0f, _value);
+    return _value;
+}
+
+static bool halfMatches(float _value, float _half) {
+    float target = expected(_value);
+    if (std::isinf(target) || target == 0.0f)
+        return _half == target && std::signbit(_half) == std::signbit(target);
+    if (target != _value)
+        return _half == target;
+
+    // the closest half, within half an ulp
+    int exponent;
+    std::frexp(_value, &exponent);
+    float ulp = std::ldexp(1.0f, std::max(exponent, -13) - 11);
+    return std::fabs(_half - _value) <= ulp * 0.5f;
+}
+
+// Enough pixels per row to go through the vectorized conversion and its scalar tail
+static std::vector<float> makePixels(int _width, int _height, int _channels) {
+    std::vector<float> pixels((size_t)_width * _height * _channels);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = s_values[i % s_count];
+    return pixels;
+}
+
+static void testHalves() {
+    const int width = 13;
+    const int height = 37;
+    std::vector<float> pixels = makePixels(width, height, 4);
+    pixels[7] = std::numeric_limits<float>::infinity();
+    pixels[8] = -std::numeric_limits<float>::infinity();
+    pixels[9] = std::numeric_limits<float>::quiet_NaN();
+
+    const ExrCompression compressions[3] = { EXR_NONE, EXR_ZIPS, EXR_ZIP };
+    const int codes[3] = { 0, 2, 3 };       // as stored in the header
+    const int strips[2] = { 1, 3 };
+    for (int c = 0; c < 3; c++)
+        for (int s = 0; s < 2; s++) {
+            ImageEncoderSettings settings;
+            settings.exr = compressions[c];
+            settings.strips = strips[s];
+            CHECK(savePixelsEXR("test_halves.exr", pixels.data(), width, height, settings));
+
+            ExrImage image;
+            CHECK(decodeEXR("test_halves.exr", image));
+            CHECK(image.width == width && image.height == height);
+            CHECK(image.compression == codes[c]);
+            CHECK(image.names.size() == 4);
+            if (image.names.size() != 4)
+                continue;
+
+            // channels in alphabetical order, rows top-down
+            const char* names[4] = { "A", "B", "G", "R" };
+            int failed = 0;
+            for (int ch = 0; ch < 4; ch++) {
+                CHECK(image.names[ch] == names[ch]);
+                CHECK(image.types[ch] == 1);
+                for (int y = 0; y < height; y++)
+                    for (int x = 0; x < width; x++) {
+                        size_t index = ((size_t)(height - 1 - y) * width + x) * 4 + (3 - ch);
+                        float half = image.channels[ch][(size_t)y * width + x];
+                        if (index == 7 || index == 8) {
+                            if (half != pixels[index])
+                                failed++;
+                        }
+                        else if (index == 9) {
+                            if (!std::isnan(half))
+                                failed++;
+                        }
+                        else if (!halfMatches(pixels[index], half))
+                            failed++;
+                    }
+            }
+            CHECK(failed == 0);
+        }
+    remove("test_halves.exr");
+}
+
+// Data passes keep full float precision, a single channel is depth (Z)
+static void testFloats() {
+    const int width = 9;
+    const int height = 20;
+    std::vector<float> depth((size_t)width * height);
+    for (size_t i = 0; i < depth.size(); i++)
+        depth[i] = 1.0f / (1.0f + (float)i * 0.37f);
+
+    ImageEncoderSettings settings;
+    CHECK(savePixelsData("test_depth.exr", depth.data(), width, height, 1, settings));
+
+    ExrImage image;
+    CHECK(decodeEXR("test_depth.exr", image));
+    CHECK(image.names.size() == 1);
+    if (image.names.size() != 1)
+        return;
+    CHECK(image.names[0] == "Z");
+    CHECK(image.types[0] == 2);
+
+    bool same = true;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            same = same && image.channels[0][(size_t)y * width + x] == depth[(size_t)(height - 1 - y) * width + x];
+    CHECK(same);
+    remove("test_depth.exr");
+}
+
+int main() {
+    testHalves();
+    testFloats();
+    return checkResult("imageEXR");
+}
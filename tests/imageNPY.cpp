@@ -0,0 +1,66 @@
+#include "check.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "imageEncoder.h"
+
+static std::vector<unsigned char> readFile(const std::string& _path) {
+    std::vector<unsigned char> bytes;
+    FILE* file = fopen(_path.c_str(), "rb");
+    if (!file)
+        return bytes;
+    unsigned char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+    return bytes;
+}
+
+static void testNPY(int _width, int _height, int _channels, const std::string& _shape) {
+    std::vector<float> pixels((size_t)_width * _height * _channels);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (float)i * 0.25f - 3.0f;
+
+    ImageEncoderSettings settings;
+    CHECK(savePixelsData("test.npy", pixels.data(), _width, _height, _channels, settings));
+    std::vector<unsigned char> bytes = readFile("test.npy");
+    remove("test.npy");
+    CHECK(bytes.size() > 10);
+    if (bytes.size() <= 10)
+        return;
+
+    // version 1.0, with the data aligned to 64 bytes
+    const unsigned char magic[8] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0 };
+    CHECK(memcmp(bytes.data(), magic, 8) == 0);
+    size_t length = bytes[8] | (bytes[9] << 8);
+    CHECK((10 + length) % 64 == 0);
+    CHECK(bytes.size() == 10 + length + pixels.size() * sizeof(float));
+    if (bytes.size() != 10 + length + pixels.size() * sizeof(float))
+        return;
+
+    std::string dict(bytes.begin() + 10, bytes.begin() + 10 + length);
+    CHECK(dict.back() == '\n');
+    CHECK(dict.find("'descr': '<f4'") != std::string::npos);
+    CHECK(dict.find("'fortran_order': False") != std::string::npos);
+    CHECK(dict.find("'shape': " + _shape) != std::string::npos);
+
+    // rows top-down
+    size_t stride = (size_t)_width * _channels;
+    const unsigned char* data = &bytes[10 + length];
+    bool same = true;
+    for (int y = 0; y < _height; y++)
+        same = same && memcmp(data + y * stride * sizeof(float), &pixels[(size_t)(_height - 1 - y) * stride], stride * sizeof(float)) == 0;
+    CHECK(same);
+}
+
+int main() {
+    testNPY(5, 3, 4, "(3, 5, 4)");
+    testNPY(7, 2, 1, "(2, 7)");
+    testNPY(1, 1, 1, "(1, 1)");
+    testNPY(640, 480, 4, "(480, 640, 4)");
+    return checkResult("imageNPY");
+}
@@ -0,0 +1,125 @@
+#include "check.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "imageEncoder.h"
+#include "pngDecoder.h"
+
+// Deterministic noise over a few gradients, so every filter has something to do
+static std::vector<unsigned char> makePixels(int _width, int _height) {
+    std::vector<unsigned char> pixels((size_t)_width * _height * 4);
+    unsigned int seed = 12345;
+    for (int y = 0; y < _height; y++)
+        for (int x = 0; x < _width; x++) {
+            unsigned char* p = &pixels[((size_t)y * _width + x) * 4];
+            seed = seed * 1103515245u + 12345u;
+            p[0] = (unsigned char)(x * 3);
+            p[1] = (unsigned char)(y * 5);
+            p[2] = (unsigned char)((x + y) & 0xF0) | ((seed >> 16) & 0x0F);
+            p[3] = (unsigned char)(seed >> 24);
+        }
+    return pixels;
+}
+
+// True if the top-down _decoded rows are the bottom-up _pixels
+static bool sameFlipped(const std::vector<unsigned char>& _pixels, const std::vector<unsigned char>& _decoded, int _width, int _height) {
+    size_t stride = (size_t)_width * 4;
+    if (_decoded.size() != _pixels.size())
+        return false;
+    for (int y = 0; y < _height; y++)
+        if (!std::equal(&_pixels[(size_t)(_height - 1 - y) * stride], &_pixels[(size_t)(_height - y) * stride - 1] + 1, &_decoded[(size_t)y * stride]))
+            return false;
+    return true;
+}
+
+// Strips are deflated apart and stitched together with adler32_combine
+static void testStrips() {
+    const int width = 37;
+    const int height = 130;
+    std::vector<unsigned char> pixels = makePixels(width, height);
+
+    const PngFilter filters[4] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_ADAPTIVE };
+    const int strips[4] = { 1, 2, 3, 8 };
+    const int levels[3] = { 0, 1, 9 };
+
+    for (int f = 0; f < 4; f++)
+        for (int s = 0; s < 4; s++)
+            for (int l = 0; l < 3; l++) {
+                ImageEncoderSettings settings;
+                settings.filter = filters[f];
+                settings.strips = strips[s];
+                settings.level = levels[l];
+
+                CHECK(savePixelsPNG("test_strips.png", pixels.data(), width, height, settings));
+
+                int w = 0, h = 0, idats = 0;
+                std::vector<unsigned char> decoded;
+                CHECK(decodePNG("test_strips.png", w, h, decoded, &idats));
+                CHECK(w == width && h == height);
+                CHECK(sameFlipped(pixels, decoded, width, height));
+
+                // the zlib header, one IDAT per strip and the adler32
+                CHECK(idats == strips[s] + 2);
+            }
+    remove("test_strips.png");
+}
+
+// Strips never get shorter than 16 rows
+static void testSmall() {
+    const int sizes[3][2] = { {1, 1}, {5, 17}, {64, 15} };
+    for (int i = 0; i < 3; i++) {
+        int width = sizes[i][0];
+        int height = sizes[i][1];
+        std::vector<unsigned char> pixels = makePixels(width, height);
+
+        ImageEncoderSettings settings;
+        settings.strips = 4;
+        CHECK(savePixelsPNG("test_small.png", pixels.data(), width, height, settings));
+
+        int w = 0, h = 0, idats = 0;
+        std::vector<unsigned char> decoded;
+        CHECK(decodePNG("test_small.png", w, h, decoded, &idats));
+        CHECK(w == width && h == height);
+        CHECK(sameFlipped(pixels, decoded, width, height));
+        CHECK(idats == 3);
+    }
+    remove("test_small.png");
+}
+
+static void testTGA() {
+    const int width = 3;
+    const int height = 2;
+    std::vector<unsigned char> pixels = makePixels(width, height);
+    CHECK(savePixelsTGA("test.tga", pixels.data(), width, height));
+
+    FILE* file = fopen("test.tga", "rb");
+    CHECK(file != nullptr);
+    if (!file)
+        return;
+    unsigned char data[18 + width * height * 4];
+    CHECK(fread(data, 1, sizeof(data), file) == sizeof(data));
+    CHECK(fgetc(file) == EOF);
+    fclose(file);
+    remove("test.tga");
+
+    CHECK(data[2] == 2);
+    CHECK(data[12] == width && data[13] == 0);
+    CHECK(data[14] == height && data[15] == 0);
+    CHECK(data[16] == 32 && data[17] == 8);
+
+    // BGRA, bottom-up like the pixels
+    for (int i = 0; i < width * height; i++) {
+        CHECK(data[18 + i * 4    ] == pixels[i * 4 + 2]);
+        CHECK(data[18 + i * 4 + 1] == pixels[i * 4 + 1]);
+        CHECK(data[18 + i * 4 + 2] == pixels[i * 4    ]);
+        CHECK(data[18 + i * 4 + 3] == pixels[i * 4 + 3]);
+    }
+}
+
+int main() {
+    testStrips();
+    testSmall();
+    testTGA();
+    return checkResult("imagePNG");
+}
@@ -0,0 +1,128 @@
+#include "check.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+
+#include "imageEncoder.h"
+#include "pngDecoder.h"
+
+static std::vector<unsigned char> makePixels(int _width, int _height) {
+    std::vector<unsigned char> pixels((size_t)_width * _height * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (unsigned char)((i * 7) ^ (i >> 5));
+    return pixels;
+}
+
+// Bands of _band rows, from the top of the bottom-up _pixels down, like tiled screenshots
+static bool writeBands(ImageStreamWriter& _writer, const std::vector<unsigned char>& _pixels, int _width, int _height, int _band) {
+    size_t stride = (size_t)_width * 4;
+    bool ok = true;
+    for (int top = _height; top > 0; top -= _band) {
+        int rows = std::min(_band, top);
+        ok = _writer.write(&_pixels[(size_t)(top - rows) * stride], rows) && ok;
+    }
+    return ok;
+}
+
+static void testPNG() {
+    const int width = 23;
+    const int height = 41;
+    std::vector<unsigned char> pixels = makePixels(width, height);
+
+    const int bands[3] = { 1, 8, 41 };
+    const PngFilter filters[2] = { PNG_FILTER_UP, PNG_FILTER_ADAPTIVE };
+    for (int b = 0; b < 3; b++)
+        for (int f = 0; f < 2; f++) {
+            ImageEncoderSettings settings;
+            settings.filter = filters[f];
+
+            ImageStreamWriter writer;
+            CHECK(writer.open("test_stream.png", width, height, settings));
+            CHECK(writer.isOpen());
+            CHECK(writeBands(writer, pixels, width, height, bands[b]));
+            CHECK(writer.getRow() == height);
+            CHECK(writer.close());
+            CHECK(!writer.isOpen());
+
+            int w = 0, h = 0;
+            std::vector<unsigned char> decoded;
+            CHECK(decodePNG("test_stream.png", w, h, decoded));
+            CHECK(w == width && h == height);
+
+            size_t stride = (size_t)width * 4;
+            bool same = decoded.size() == pixels.size();
+            for (int y = 0; y < height && same; y++)
+                same = std::equal(&decoded[(size_t)y * stride], &decoded[(size_t)y * stride] + stride, &pixels[(size_t)(height - 1 - y) * stride]);
+            CHECK(same);
+        }
+    remove("test_stream.png");
+}
+
+static void testTGA() {
+    const int width = 5;
+    const int height = 7;
+    std::vector<unsigned char> pixels = makePixels(width, height);
+
+    ImageEncoderSettings settings;
+    ImageStreamWriter writer;
+    CHECK(writer.open("test_stream.tga", width, height, settings));
+    CHECK(writeBands(writer, pixels, width, height, 3));
+    CHECK(writer.close());
+
+    FILE* file = fopen("test_stream.tga", "rb");
+    CHECK(file != nullptr);
+    if (!file)
+        return;
+    unsigned char data[18 + width * height * 4];
+    CHECK(fread(data, 1, sizeof(data), file) == sizeof(data));
+    fclose(file);
+    remove("test_stream.tga");
+
+    // origin at the top-left, so rows are top-down
+    CHECK(data[12] == width && data[14] == height);
+    CHECK(data[17] == (8 | 0x20));
+    bool same = true;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) {
+            const unsigned char* src = &pixels[((size_t)(height - 1 - y) * width + x) * 4];
+            const unsigned char* dst = &data[18 + (y * width + x) * 4];
+            same = same && dst[0] == src[2] && dst[1] == src[1] && dst[2] == src[0] && dst[3] == src[3];
+        }
+    CHECK(same);
+}
+
+static void testErrors() {
+    ImageEncoderSettings settings;
+    ImageStreamWriter writer;
+
+    // TGA headers store the size in 16 bits
+    CHECK(!writer.open("test_big.tga", 70000, 16, settings));
+    CHECK(!writer.open("test_big.tga", 16, 65536, settings));
+    CHECK(!writer.isOpen());
+
+    CHECK(!writer.open("test_stream.jpg", 16, 16, settings));
+    CHECK(!writer.isOpen());
+
+    // closing before all the rows are there fails
+    std::vector<unsigned char> pixels = makePixels(4, 4);
+    CHECK(writer.open("test_short.png", 4, 8, settings));
+    CHECK(writer.write(pixels.data(), 4));
+    CHECK(!writer.close());
+    CHECK(!writer.write(pixels.data(), 4));
+    remove("test_short.png");
+
+    // extra rows are ignored
+    CHECK(writer.open("test_extra.tga", 4, 2, settings));
+    CHECK(writer.write(pixels.data(), 4));
+    CHECK(writer.getRow() == 2);
+    CHECK(writer.close());
+    remove("test_extra.tga");
+}
+
+int main() {
+    testPNG();
+    testTGA();
+    testErrors();
+    return checkResult("imageStream");
+}
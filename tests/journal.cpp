@@ -0,0 +1,155 @@
+#include "check.h"
+
+#include <cstdio>
+#include <thread>
+#include <string>
+#include <vector>
+
+#include "journal.h"
+
+static void writeFile(const std::string& _path, size_t _bytes) {
+    FILE* file = fopen(_path.c_str(), "wb");
+    if (!file)
+        return;
+    for (size_t i = 0; i < _bytes; i++)
+        fputc('x', file);
+    fclose(file);
+}
+
+static std::vector<std::string> list(const std::string& _a, const std::string& _b = "") {
+    std::vector<std::string> files(1, _a);
+    if (!_b.empty())
+        files.push_back(_b);
+    return files;
+}
+
+static void testFresh() {
+    writeFile("journal_a.png", 10);
+    writeFile("journal_b.png", 20);
+    writeFile("journal c.png", 30);     // names can have spaces
+    writeFile("journal_empty.png", 0);
+
+    RecordingJournal journal;
+    CHECK(!journal.isOpen());
+    CHECK(journal.open("test.journal", false));
+    CHECK(journal.isOpen());
+    CHECK(!journal.isResuming());
+    CHECK(journal.getPath() == "test.journal");
+
+    journal.add("journal_a.png");
+    journal.add("journal c.png");
+    journal.add("journal_missing.png");     // not on disk, ignored
+    journal.add("journal_empty.png");       // nothing was written, ignored
+
+    CHECK(journal.isComplete(list("journal_a.png")));
+    CHECK(journal.isComplete(list("journal_a.png", "journal c.png")));
+    CHECK(!journal.isComplete(list("journal_a.png", "journal_b.png")));
+    CHECK(!journal.isComplete(list("journal_missing.png")));
+    CHECK(!journal.isComplete(list("journal_empty.png")));
+    CHECK(!journal.isComplete(std::vector<std::string>()));
+    journal.close();
+    CHECK(!journal.isOpen());
+}
+
+static void testResume() {
+    RecordingJournal journal;
+    CHECK(journal.open("test.journal", true));
+    CHECK(journal.isResuming());
+    CHECK(journal.isComplete(list("journal_a.png", "journal c.png")));
+    CHECK(!journal.isComplete(list("journal_b.png")));
+
+    // files that changed or went away since have to be saved again
+    writeFile("journal_a.png", 11);
+    CHECK(!journal.isComplete(list("journal_a.png")));
+    remove("journal c.png");
+    CHECK(!journal.isComplete(list("journal c.png")));
+
+    journal.add("journal_a.png");
+    journal.add("journal_b.png");
+    journal.close();
+
+    // the latest entry of a file wins
+    CHECK(journal.open("test.journal", true));
+    CHECK(journal.isComplete(list("journal_a.png", "journal_b.png")));
+    journal.close();
+
+    // starting over forgets everything
+    CHECK(journal.open("test.journal", false));
+    CHECK(!journal.isComplete(list("journal_a.png")));
+    journal.close();
+    CHECK(journal.open("test.journal", true));
+    CHECK(!journal.isComplete(list("journal_a.png")));
+    journal.close();
+}
+
+// A crash can leave the last line cut
+static void testTornLine() {
+    RecordingJournal journal;
+    CHECK(journal.open("test.journal", false));
+    journal.add("journal_a.png");
+    journal.close();
+
+    FILE* file = fopen("test.journal", "a");
+    CHECK(file != nullptr);
+    if (!file)
+        return;
+    fputs("20 journal_b.p", file);
+    fclose(file);
+
+    CHECK(journal.open("test.journal", true));
+    CHECK(journal.isComplete(list("journal_a.png")));
+    CHECK(!journal.isComplete(list("journal_b.png")));
+    journal.add("journal_b.png");
+    journal.close();
+
+    CHECK(journal.open("test.journal", true));
+    CHECK(journal.isComplete(list("journal_a.png", "journal_b.png")));
+    journal.close();
+}
+
+// Saving threads add files at the same time
+static void testThreads() {
+    const int threads = 4;
+    const int files = 50;
+    for (int t = 0; t < threads; t++)
+        for (int i = 0; i < files; i++)
+            writeFile("journal_" + std::to_string(t) + "_" + std::to_string(i) + ".png", 1 + i);
+
+    RecordingJournal journal;
+    CHECK(journal.open("test.journal", false));
+    std::vector<std::thread> savers;
+    for (int t = 0; t < threads; t++)
+        savers.push_back(std::thread([&journal, t]() {
+            for (int i = 0; i < files; i++)
+                journal.add("journal_" + std::to_string(t) + "_" + std::to_string(i) + ".png");
+        }));
+    for (size_t t = 0; t < savers.size(); t++)
+        savers[t].join();
+    journal.close();
+
+    CHECK(journal.open("test.journal", true));
+    int missing = 0;
+    for (int t = 0; t < threads; t++)
+        for (int i = 0; i < files; i++) {
+            std::string path = "journal_" + std::to_string(t) + "_" + std::to_string(i) + ".png";
+            if (!journal.isComplete(list(path)))
+                missing++;
+            remove(path.c_str());
+        }
+    CHECK(missing == 0);
+    journal.close();
+}
+
+int main() {
+    testFresh();
+    testResume();
+    testTornLine();
+    testThreads();
+
+    remove("journal_a.png");
+    remove("journal_b.png");
+    remove("journal c.png");
+    remove("journal_empty.png");
+    remove("test.journal");
+    return checkResult("journal");
+}
@@ -0,0 +1,133 @@
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "lockFreeQueue.h"
+
+// A one byte frame holding _value
+static SharedPixels frame(unsigned char _value) {
+    SharedPixels pixels(new unsigned char[1], std::default_delete<unsigned char[]>());
+    pixels.get()[0] = _value;
+    return pixels;
+}
+
+static void testOrder() {
+    LockFreeQueue queue(4);
+    CHECK(queue.getCapacity() == 4);
+    CHECK(queue.size() == 0);
+
+    SharedPixels pixels;
+    CHECK(!queue.consume(pixels));
+
+    for (int i = 0; i < 4; i++)
+        CHECK(queue.produce(frame(i)));
+    CHECK(queue.size() == 4);
+
+    for (int i = 0; i < 4; i++) {
+        CHECK(queue.consume(pixels));
+        CHECK(pixels && pixels.get()[0] == i);
+    }
+    CHECK(queue.size() == 0);
+    CHECK(!queue.consume(pixels));
+}
+
+static void testWrapAround() {
+    LockFreeQueue queue(3);
+    SharedPixels pixels;
+    for (int i = 0; i < 100; i++) {
+        CHECK(queue.produce(frame(i)));
+        CHECK(queue.produce(frame(i + 100)));
+        CHECK(queue.consume(pixels) && pixels.get()[0] == i);
+        CHECK(queue.consume(pixels) && pixels.get()[0] == i + 100);
+    }
+    CHECK(queue.size() == 0);
+}
+
+static void testDrop() {
+    LockFreeQueue queue(2, QUEUE_DROP);
+    CHECK(queue.getPolicy() == QUEUE_DROP);
+    CHECK(queue.produce(frame(1)));
+    CHECK(queue.produce(frame(2)));
+    CHECK(!queue.produce(frame(3)));
+    CHECK(!queue.produce(frame(4)));
+    CHECK(queue.getDropped() == 2);
+    CHECK(queue.size() == 2);
+
+    // the frames that made it in are the first ones
+    SharedPixels pixels;
+    CHECK(queue.consume(pixels) && pixels.get()[0] == 1);
+    CHECK(queue.produce(frame(5)));
+    CHECK(queue.consume(pixels) && pixels.get()[0] == 2);
+    CHECK(queue.consume(pixels) && pixels.get()[0] == 5);
+
+    queue.setCapacity(8);
+    CHECK(queue.getCapacity() == 8);
+    CHECK(queue.getDropped() == 0);
+    CHECK(queue.size() == 0);
+
+    // a capacity of zero still holds one frame
+    queue.setCapacity(0);
+    CHECK(queue.getCapacity() == 1);
+}
+
+// One producer and one consumer, with the producer waiting on a full ring
+static void testThreads() {
+    const int total = 20000;
+    LockFreeQueue queue(8, QUEUE_BLOCK);
+
+    std::thread producer([&queue]() {
+        for (int i = 0; i < total; i++)
+            queue.produce(frame(i % 256));
+    });
+
+    int received = 0;
+    int outOfOrder = 0;
+    SharedPixels pixels;
+    while (received < total) {
+        if (queue.consume(pixels)) {
+            if (pixels.get()[0] != received % 256)
+                outOfOrder++;
+            received++;
+        }
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+
+    CHECK(outOfOrder == 0);
+    CHECK(queue.getDropped() == 0);
+    CHECK(queue.size() == 0);
+}
+
+// A producer blocked on a full ring goes on as soon as one frame is consumed
+static void testWakeUp() {
+    LockFreeQueue queue(1, QUEUE_BLOCK);
+    CHECK(queue.produce(frame(1)));
+
+    std::atomic<bool> produced(false);
+    std::thread producer([&queue, &produced]() {
+        queue.produce(frame(2));
+        produced = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!produced.load());
+
+    SharedPixels pixels;
+    CHECK(queue.consume(pixels) && pixels.get()[0] == 1);
+    producer.join();
+
+    CHECK(produced.load());
+    CHECK(queue.consume(pixels) && pixels.get()[0] == 2);
+}
+
+int main() {
+    testOrder();
+    testWrapAround();
+    testDrop();
+    testThreads();
+    testWakeUp();
+    return checkResult("lockFreeQueue");
+}
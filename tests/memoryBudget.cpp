@@ -0,0 +1,96 @@
+#include "check.h"
+
+#include <thread>
+#include <vector>
+
+#include "memoryBudget.h"
+
+static void testFits() {
+    MemoryBudget budget(100);
+    CHECK(budget.getLimit() == 100);
+    CHECK(budget.fits(100));
+    CHECK(budget.fits(1000));   // a single job always fits
+
+    budget.reserve(60);
+    CHECK(budget.getInFlight() == 60);
+    CHECK(budget.getJobs() == 1);
+    CHECK(budget.fits(40));
+    CHECK(!budget.fits(41));
+
+    budget.reserve(40);
+    CHECK(!budget.fits(1));
+
+    budget.release(60);
+    CHECK(budget.getInFlight() == 40);
+    CHECK(budget.getJobs() == 1);
+    CHECK(budget.fits(60));
+
+    budget.release(40);
+    CHECK(budget.getInFlight() == 0);
+    CHECK(budget.getJobs() == 0);
+}
+
+static void testOversized() {
+    // frames bigger than the limit go through one at a time
+    MemoryBudget budget(100);
+    budget.reserve(250);
+    CHECK(budget.getInFlight() == 250);
+    CHECK(!budget.fits(1));
+    budget.release(250);
+    CHECK(budget.fits(250));
+}
+
+static void testLimit() {
+    MemoryBudget budget(100);
+    budget.reserve(80);
+    CHECK(!budget.fits(30));
+    budget.setLimit(200);
+    CHECK(budget.getLimit() == 200);
+    CHECK(budget.fits(30));
+    budget.setLimit(50);
+    CHECK(!budget.fits(1));
+    budget.release(80);
+}
+
+static void testBigFrames() {
+    // 8K float RGBA frames go past 32 bits
+    const size_t frame = (size_t)7680 * 4320 * 4 * sizeof(float);
+    MemoryBudget budget(2 * (long long)frame);
+    budget.reserve(frame);
+    CHECK(budget.getInFlight() == (long long)frame);
+    CHECK(budget.fits(frame));
+    budget.reserve(frame);
+    CHECK(!budget.fits(frame));
+    budget.release(frame);
+    budget.release(frame);
+    CHECK(budget.getInFlight() == 0);
+}
+
+// The render thread reserves, the saving threads release
+static void testThreads() {
+    MemoryBudget budget(1024);
+
+    std::vector<std::thread> savers;
+    for (int t = 0; t < 4; t++) {
+        savers.push_back(std::thread([&budget]() {
+            for (int i = 0; i < 1000; i++) {
+                budget.reserve(256);
+                budget.release(256);
+            }
+        }));
+    }
+    for (size_t t = 0; t < savers.size(); t++)
+        savers[t].join();
+
+    CHECK(budget.getInFlight() == 0);
+    CHECK(budget.getJobs() == 0);
+}
+
+int main() {
+    testFits();
+    testOversized();
+    testLimit();
+    testBigFrames();
+    testThreads();
+    return checkResult("memoryBudget");
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <zlib.h>
+
+// Reads the 8 bits RGBA PNG files glslViewer writes, checking the CRC of every chunk
+// and the zlib stream (the adler32 at its end included). _pixels are top-down rows
+// and _idats counts the IDAT chunks, to tell how many strips were encoded
+inline bool decodePNG(const std::string& _path, int& _width, int& _height, std::vector<unsigned char>& _pixels, int* _idats = nullptr) {
+    FILE* file = fopen(_path.c_str(), "rb");
+    if (!file)
+        return false;
+    std::vector<unsigned char> bytes;
+    unsigned char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    if (bytes.size() < 8 || !std::equal(signature, signature + 8, bytes.begin()))
+        return false;
+
+    std::vector<unsigned char> zdata;
+    bool end = false;
+    int idats = 0;
+    _width = _height = 0;
+    for (size_t p = 8; p + 12 <= bytes.size() && !end; ) {
+        unsigned long size = ((unsigned long)bytes[p] << 24) | (bytes[p + 1] << 16) | (bytes[p + 2] << 8) | bytes[p + 3];
+        if (p + 12 + size > bytes.size())
+            return false;
+        const unsigned char* type = &bytes[p + 4];
+        const unsigned char* data = &bytes[p + 8];
+        const unsigned char* tail = data + size;
+        unsigned long crc = ((unsigned long)tail[0] << 24) | (tail[1] << 16) | (tail[2] << 8) | tail[3];
+        if (crc32(crc32(0L, type, 4), data, (uInt)size) != crc)
+            return false;
+
+        std::string name(type, type + 4);
+        if (name == "IHDR") {
+            _width  = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+            _height = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+            if (data[8] != 8 || data[9] != 6 || data[12] != 0)
+                return false;
+        }
+        else if (name == "IDAT") {
+            zdata.insert(zdata.end(), data, data + size);
+            idats++;
+        }
+        else if (name == "IEND")
+            end = true;
+        p += 12 + size;
+    }
+    if (!end || _width <= 0 || _height <= 0)
+        return false;
+    if (_idats)
+        *_idats = idats;
+
+    size_t stride = (size_t)_width * 4;
+    std::vector<unsigned char> filtered((stride + 1) * _height);
+    uLongf length = (uLongf)filtered.size();
+    if (uncompress(filtered.data(), &length, zdata.data(), (uLong)zdata.size()) != Z_OK || length != filtered.size())
+        return false;
+
+    _pixels.assign(stride * _height, 0);
+    for (int y = 0; y < _height; y++) {
+        const unsigned char* in = &filtered[y * (stride + 1)];
+        unsigned char* row = &_pixels[y * stride];
+        const unsigned char* prev = (y > 0)? row - stride : nullptr;
+        for (size_t x = 0; x < stride; x++) {
+            int a = (x >= 4)? row[x - 4] : 0;
+            int b = prev? prev[x] : 0;
+            int c = (prev && x >= 4)? prev[x - 4] : 0;
+            int predictor = 0;
+            switch (in[0]) {
+                case 0: predictor = 0; break;
+                case 1: predictor = a; break;
+                case 2: predictor = b; break;
+                case 3: predictor = (a + b) / 2; break;
+                case 4: {
+                    int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+                    predictor = (pa <= pb && pa <= pc)? a : ((pb <= pc)? b : c);
+                    break;
+                }
+                default: return false;
+            }
+            row[x] = (unsigned char)(in[x + 1] + predictor);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,206 @@
+#include "check.h"
+
+#include <set>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+
+#include "sweep.h"
+
+static bool loadSpec(ParameterSweep& _sweep, const std::string& _spec) {
+    std::ofstream out("test_sweep.csv");
+    out << _spec;
+    out.close();
+    bool ok = _sweep.load("test_sweep.csv");
+    remove("test_sweep.csv");
+    return ok;
+}
+
+// All the samples, in order
+static std::vector< std::vector<std::string> > getSamples(ParameterSweep& _sweep) {
+    std::vector< std::vector<std::string> > samples;
+    std::vector<std::string> values;
+    std::string file;
+    _sweep.start();
+    while (_sweep.next(values, file)) {
+        samples.push_back(values);
+        remove(file.c_str());
+        remove((file.substr(0, file.rfind('.')) + ".json").c_str());
+    }
+    _sweep.finish();
+    return samples;
+}
+
+// How many times the value of parameter _p changes along the samples
+static int getChanges(const std::vector< std::vector<std::string> >& _samples, size_t _p) {
+    int changes = 0;
+    for (size_t i = 1; i < _samples.size(); i++)
+        if (_samples[i][_p] != _samples[i - 1][_p])
+            changes++;
+    return changes;
+}
+
+static void testGrid() {
+    ParameterSweep sweep;
+    CHECK(loadSpec(sweep,
+        "# every combination\n"
+        "mode,grid\n"
+        "output,test_grid_\n"
+        "uniform,u_a,0,1,3\n"
+        "define,MODE,A,B\n"
+        "uniform,u_b,-1,1,2   # comments go anywhere\n"
+        "uniform,u_c,2,4,1\n"));
+    CHECK(sweep.getParameters().size() == 4);
+    CHECK(sweep.getTotal() == 12);
+
+    std::vector< std::vector<std::string> > samples = getSamples(sweep);
+    CHECK(samples.size() == 12);
+
+    std::set< std::vector<std::string> > unique(samples.begin(), samples.end());
+    CHECK(unique.size() == 12);
+
+    std::set<float> a, b, c;
+    for (size_t i = 0; i < samples.size(); i++) {
+        a.insert((float)atof(samples[i][0].c_str()));
+        b.insert((float)atof(samples[i][2].c_str()));
+        c.insert((float)atof(samples[i][3].c_str()));
+    }
+    CHECK(a == std::set<float>({ 0.0f, 0.5f, 1.0f }));
+    CHECK(b == std::set<float>({ -1.0f, 1.0f }));
+    CHECK(c == std::set<float>({ 3.0f }));      // a single step is the middle of the range
+
+    // defines change the least, so shaders recompile once per value
+    CHECK(getChanges(samples, 1) == 1);
+}
+
+static void testRandom() {
+    const std::string spec =
+        "mode,random\n"
+        "samples,50\n"
+        "output,test_random_\n"
+        "uniform,u_a,-2,3\n"
+        "define,MODE,A,B,C\n";
+
+    ParameterSweep sweep;
+    CHECK(loadSpec(sweep, spec + "seed,7\n"));
+    CHECK(sweep.getTotal() == 50);
+    std::vector< std::vector<std::string> > first = getSamples(sweep);
+
+    bool inRange = true;
+    for (size_t i = 0; i < first.size(); i++) {
+        float value = (float)atof(first[i][0].c_str());
+        inRange = inRange && value >= -2.0f && value <= 3.0f;
+    }
+    CHECK(inRange);
+    CHECK(getChanges(first, 1) <= 2);
+
+    // the same seed gives the same samples, another one doesn't
+    CHECK(loadSpec(sweep, spec + "seed,7\n"));
+    CHECK(getSamples(sweep) == first);
+    CHECK(loadSpec(sweep, spec + "seed,8\n"));
+    CHECK(getSamples(sweep) != first);
+}
+
+static void testLatinHypercube() {
+    const int count = 12;
+    ParameterSweep sweep;
+    CHECK(loadSpec(sweep,
+        "mode,lhs\n"
+        "samples," + std::to_string(count) + "\n"
+        "seed,3\n"
+        "output,test_lhs_\n"
+        "uniform,u_a,0,12\n"
+        "uniform,u_b,10,34\n"
+        "define,MODE,A,B,C\n"));
+    std::vector< std::vector<std::string> > samples = getSamples(sweep);
+    CHECK(samples.size() == (size_t)count);
+
+    // every uniform falls once in each of its strata
+    std::vector<int> a(count, 0), b(count, 0);
+    for (size_t i = 0; i < samples.size(); i++) {
+        int sa = (int)std::floor(atof(samples[i][0].c_str()));
+        int sb = (int)std::floor((atof(samples[i][1].c_str()) - 10.0) / 2.0);
+        if (sa >= 0 && sa < count) a[sa]++;
+        if (sb >= 0 && sb < count) b[sb]++;
+    }
+    CHECK(a == std::vector<int>(count, 1));
+    CHECK(b == std::vector<int>(count, 1));
+
+    // and so does every define value, grouped together
+    int modes[3] = { 0, 0, 0 };
+    for (size_t i = 0; i < samples.size(); i++)
+        if (samples[i][2].size() == 1 && samples[i][2][0] >= 'A' && samples[i][2][0] <= 'C')
+            modes[samples[i][2][0] - 'A']++;
+    CHECK(modes[0] == 4 && modes[1] == 4 && modes[2] == 4);
+    CHECK(getChanges(samples, 2) == 2);
+}
+
+static void testFrames() {
+    ParameterSweep sweep;
+    CHECK(loadSpec(sweep,
+        "output,test_frames_\n"
+        "format,exr\n"
+        "uniform,u_a,0,1,2\n"
+        "define,MODE,A\n"));
+    CHECK(!sweep.isRunning());
+
+    std::vector<std::string> values;
+    std::string file;
+    CHECK(!sweep.next(values, file));     // not started
+
+    sweep.start();
+    CHECK(sweep.isRunning());
+    CHECK(sweep.next(values, file));
+    CHECK(file == "test_frames_00000.exr");
+    CHECK(values.size() == 2 && values[1] == "A");
+    CHECK(sweep.getCurrent() == 1);
+
+    std::ifstream json("test_frames_00000.json");
+    CHECK(json.is_open());
+    std::string text((std::istreambuf_iterator<char>(json)), std::istreambuf_iterator<char>());
+    json.close();
+    CHECK(text.find("\"index\": 0") != std::string::npos);
+    CHECK(text.find("\"file\": \"test_frames_00000.exr\"") != std::string::npos);
+    CHECK(text.find("\"u_a\": " + values[0]) != std::string::npos);
+    CHECK(text.find("\"MODE\": \"A\"") != std::string::npos);
+    remove("test_frames_00000.json");
+
+    CHECK(sweep.next(values, file));
+    CHECK(file == "test_frames_00001.exr");
+    remove("test_frames_00001.json");
+    CHECK(!sweep.next(values, file));
+
+    // only defines that change need a recompile
+    CHECK(sweep.updateDefine("MODE", "A"));
+    CHECK(!sweep.updateDefine("MODE", "A"));
+    CHECK(sweep.updateDefine("MODE", "B"));
+    sweep.start();
+    CHECK(sweep.updateDefine("MODE", "B"));
+    CHECK(sweep.getCurrent() == 0);
+
+    // finishing wakes up whoever waits
+    std::thread waiter([&sweep]() { sweep.wait(); });
+    sweep.finish();
+    waiter.join();
+    CHECK(!sweep.isRunning());
+}
+
+static void testErrors() {
+    ParameterSweep sweep;
+    CHECK(!sweep.load("test_missing_sweep.csv"));
+    CHECK(!loadSpec(sweep, "mode,grid\nsamples,4\n"));
+    CHECK(!loadSpec(sweep, "uniform,u_a,0\n"));
+}
+
+int main() {
+    testGrid();
+    testRandom();
+    testLatinHypercube();
+    testFrames();
+    testErrors();
+    return checkResult("sweep");
+}
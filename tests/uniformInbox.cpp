@@ -0,0 +1,207 @@
+#include "check.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+
+#include "uniformInbox.h"
+
+static bool push1(UniformInbox& _inbox, const std::string& _name, float _value) {
+    return _inbox.push(_name, &_value, 1, false);
+}
+
+// Uniforms where only the latest value counts (the default) take one slot each
+static void testCoalesce() {
+    UniformInbox inbox;
+    CHECK(inbox.empty());
+    for (int i = 0; i < 1000; i++)
+        CHECK(push1(inbox, "u_a", (float)i));
+    CHECK(push1(inbox, "u_b", -1.0f));
+    CHECK(!inbox.empty());
+
+    UniformSample sample;
+    CHECK(!inbox.pop(sample));      // nothing went through the queue
+
+    size_t slot = 0;
+    int found = 0;
+    while (inbox.popLatest(slot, sample)) {
+        std::string name = inbox.getName(sample.slot);
+        if (name == "u_a")
+            CHECK(sample.value[0] == 999.0f);
+        else if (name == "u_b")
+            CHECK(sample.value[0] == -1.0f);
+        else
+            CHECK(false);
+        CHECK(sample.size == 1);
+        found++;
+    }
+    CHECK(found == 2);
+    CHECK(inbox.empty());
+    CHECK(inbox.getDropped() == 0);
+
+    // once taken, they are gone until they change again
+    slot = 0;
+    CHECK(!inbox.popLatest(slot, sample));
+    CHECK(push1(inbox, "u_a", 5.0f));
+    slot = 0;
+    CHECK(inbox.popLatest(slot, sample));
+    CHECK(sample.value[0] == 5.0f);
+}
+
+// Queued uniforms keep every value in order
+static void testQueue() {
+    UniformInbox inbox(16);
+    CHECK(inbox.setCoalesce("u_q", false));
+    for (int i = 0; i < 10; i++)
+        CHECK(push1(inbox, "u_q", (float)i));
+
+    size_t slot = 0;
+    UniformSample sample;
+    CHECK(!inbox.popLatest(slot, sample));
+
+    int next = 0;
+    while (inbox.pop(sample)) {
+        CHECK(std::string(inbox.getName(sample.slot)) == "u_q");
+        CHECK(sample.value[0] == (float)next);
+        next++;
+    }
+    CHECK(next == 10);
+    CHECK(inbox.empty());
+
+    // and switch back to coalescing
+    CHECK(inbox.setCoalesce("u_q", true));
+    CHECK(push1(inbox, "u_q", 1.0f));
+    CHECK(push1(inbox, "u_q", 2.0f));
+    CHECK(!inbox.pop(sample));
+    slot = 0;
+    CHECK(inbox.popLatest(slot, sample) && sample.value[0] == 2.0f);
+}
+
+// When the render thread falls behind the oldest values go first
+static void testDropOldest() {
+    UniformInbox inbox(5);
+    CHECK(inbox.getCapacity() == 8);
+    CHECK(inbox.setCoalesce("u_q", false));
+    for (int i = 0; i < 20; i++)
+        CHECK(push1(inbox, "u_q", (float)i));
+    CHECK(inbox.getDropped() == 12);
+
+    UniformSample sample;
+    int next = 12;
+    while (inbox.pop(sample)) {
+        CHECK(sample.value[0] == (float)next);
+        next++;
+    }
+    CHECK(next == 20);
+}
+
+static void testValues() {
+    UniformInbox inbox;
+    float values[6] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+    CHECK(inbox.push("u_vec", values, 6, false));
+    CHECK(inbox.push("u_int", values, 2, true));
+
+    size_t slot = 0;
+    UniformSample sample;
+    int found = 0;
+    while (inbox.popLatest(slot, sample)) {
+        std::string name = inbox.getName(sample.slot);
+        if (name == "u_vec") {
+            CHECK(sample.size == 4);
+            CHECK(sample.value[3] == 4.0f);
+            CHECK(!sample.bInt);
+        }
+        else if (name == "u_int") {
+            CHECK(sample.size == 2);
+            CHECK(sample.value[1] == 2.0f && sample.value[2] == 0.0f);
+            CHECK(sample.bInt);
+        }
+        CHECK(sample.timestamp > 0.0 && sample.timestamp <= uniformClock());
+        found++;
+    }
+    CHECK(found == 2);
+}
+
+static void testLimits() {
+    UniformInbox inbox(16, 4);
+    std::string tooLong(UNIFORM_INBOX_NAME, 'x');
+    CHECK(!push1(inbox, tooLong, 1.0f));
+    CHECK(push1(inbox, std::string(UNIFORM_INBOX_NAME - 1, 'x'), 1.0f));
+
+    // names take a slot for good
+    CHECK(push1(inbox, "u_a", 1.0f));
+    CHECK(push1(inbox, "u_b", 1.0f));
+    CHECK(push1(inbox, "u_c", 1.0f));
+    CHECK(!push1(inbox, "u_d", 1.0f));
+    CHECK(!inbox.setCoalesce("u_d", false));
+    CHECK(push1(inbox, "u_a", 2.0f));
+}
+
+// Producers on several threads while the render thread drains: coalesced values are never
+// torn and the last one wins, queued ones keep the order of each producer
+static void testThreads() {
+    const int producers = 4;
+    const int pushes = 20000;
+    UniformInbox inbox(producers * pushes);
+    CHECK(inbox.setCoalesce("u_queued", false));
+
+    std::atomic<int> running(producers);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; t++)
+        threads.push_back(std::thread([&inbox, &running, t]() {
+            for (int i = 0; i < pushes; i++) {
+                float value[4] = { (float)i, (float)i, (float)i, (float)i };
+                inbox.push("u_latest", value, 4, false);
+                float queued[2] = { (float)t, (float)i };
+                inbox.push("u_queued", queued, 2, false);
+            }
+            running--;
+        }));
+
+    int torn = 0;
+    int outOfOrder = 0;
+    int received = 0;
+    std::vector<float> last(producers, -1.0f);
+    float latest = -1.0f;
+    bool done = false;
+    while (!done) {
+        done = running.load() == 0;
+
+        size_t slot = 0;
+        UniformSample sample;
+        while (inbox.popLatest(slot, sample)) {
+            if (sample.value[0] != sample.value[1] || sample.value[0] != sample.value[2] || sample.value[0] != sample.value[3])
+                torn++;
+            latest = sample.value[0];
+        }
+        while (inbox.pop(sample)) {
+            int producer = (int)sample.value[0];
+            if (producer < 0 || producer >= producers || sample.value[1] <= last[producer])
+                outOfOrder++;
+            else
+                last[producer] = sample.value[1];
+            received++;
+        }
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    CHECK(torn == 0);
+    CHECK(outOfOrder == 0);
+    CHECK(received == producers * pushes);
+    CHECK(inbox.getDropped() == 0);
+    CHECK(latest == (float)(pushes - 1));
+    CHECK(inbox.empty());
+}
+
+int main() {
+    testCoalesce();
+    testQueue();
+    testDropOldest();
+    testValues();
+    testLimits();
+    testThreads();
+    return checkResult("uniformInbox");
+}